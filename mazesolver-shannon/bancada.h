@@ -0,0 +1,46 @@
+/*
+ * Marcas para a bancada de ciclos (bancada/).
+ *
+ * Compilado com -DBANCADA, cada marca eh uma escrita em GPIOR0 (um "out",
+ * 1 ciclo) que o simulador AVR intercepta e anota com o contador de
+ * ciclos. Uma marca abre uma regiao e fecha a anterior; BANCADA_FIM so
+ * fecha. Sem -DBANCADA as marcas somem.
+ */
+
+#ifndef BANCADA_H
+#define BANCADA_H
+
+#define BANCADA_FIM 0
+#define BANCADA_FOLLOW_SEGMENT 1   /* uma volta do laco de follow_segment() */
+#define BANCADA_READ_LINE 2
+#define BANCADA_SIMPLIFY_PATH 3
+#define BANCADA_TESTA_SE_JA_PASSOU 4
+#define BANCADA_MAPA_PLANEJA 5
+#define BANCADA_N_MARCAS 6
+
+#define BANCADA_TERMINOU 0xff      /* o simulador para aqui */
+#define BANCADA_FALHOU 0xfe        /* ... e acusa um resultado errado */
+
+/* Padrao que o simulador poe nos sensores (escrito em GPIOR1) */
+#define BANCADA_BRANCO 0
+#define BANCADA_PRETO 1
+#define BANCADA_LINHA 2            /* linha centrada embaixo do sensor 2 */
+#define BANCADA_CRUZAMENTO 3       /* linha e fita nos sensores 0 e 4 */
+
+#if defined(BANCADA) && defined(__AVR__)
+#include <avr/io.h>
+#define BANCADA_MARCA(marca) (GPIOR0 = (marca))
+#define BANCADA_PADRAO(padrao) (GPIOR1 = (padrao))
+#else
+#define BANCADA_MARCA(marca)
+#define BANCADA_PADRAO(padrao)
+#endif
+
+#endif
+
+// Local Variables: **
+// mode: C **
+// c-basic-offset: 4 **
+// tab-width: 4 **
+// indent-tabs-mode: t **
+// end: **
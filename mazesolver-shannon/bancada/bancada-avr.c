@@ -0,0 +1,164 @@
+/*
+ * bancada-avr.c
+ *
+ * Firmware da bancada de ciclos: chama as partes do resolvedor que pesam
+ * no laco de controle, entre marcas de bancada.h, para o bancada-sim
+ * contar os ciclos no simulador AVR. Nao usa o LCD nem os botoes; os
+ * sensores sao simulados pelo bancada-sim conforme o padrao pedido.
+ *
+ * O resolvedor vem de main.c compilado com -Dmain=solver_main, como no
+ * build de host.
+ */
+
+#include "hal.h"
+#include "bancada.h"
+#include "follow-segment.h"
+#include "mapa.h"
+#include "caminho.h"
+
+#define REPETICOES 100
+
+/* Estado do resolvedor (main.c) */
+typedef struct Mapa {
+	int x;
+	int y;
+} Mapa;
+
+typedef struct Celula {
+	signed char x;
+	signed char y;
+} Celula;
+
+typedef struct Percurso {
+	char saida;
+	unsigned int distancia;
+	Celula posicao;
+} Percurso;
+
+extern Caminho path;
+extern unsigned int distancia[];
+extern Percurso percurso[];
+extern Mapa local_robo;
+extern int tam_percurso_memorizado;
+
+void simplify_path();
+int testa_se_ja_passou();
+
+static void mede_read_line()
+{
+	unsigned int sensors[5];
+	int i;
+
+	for(i = 0; i < REPETICOES; i++) {
+		BANCADA_MARCA(BANCADA_READ_LINE);
+		read_line(sensors, IR_EMITTERS_ON);
+		BANCADA_MARCA(BANCADA_FIM);
+	}
+}
+
+/* Pior caso: o penultimo passo eh um 'B' e os tres viram um so */
+static void mede_simplify_path()
+{
+	int i;
+
+	for(i = 0; i < REPETICOES; i++) {
+		caminho_limpa(&path);
+		caminho_acrescenta(&path, 'L');
+		caminho_acrescenta(&path, 'B');
+		caminho_acrescenta(&path, 'L');
+
+		BANCADA_MARCA(BANCADA_SIMPLIFY_PATH);
+		simplify_path();
+		BANCADA_MARCA(BANCADA_FIM);
+	}
+}
+
+/* Percurso cheio e o robo num lugar que nao esta nele: o mapa responde
+ * sem percorrer o vetor */
+static void mede_testa_se_ja_passou()
+{
+	int i;
+
+	for(i = 0; i < 60; i++) {
+		percurso[i].saida = NORTE;
+		percurso[i].posicao.x = i % 11;
+		percurso[i].posicao.y = i / 11;
+	}
+	tam_percurso_memorizado = 60;
+	local_robo.x = -1;
+	local_robo.y = -1;
+	mapa_limpa();
+
+	for(i = 0; i < REPETICOES; i++) {
+		BANCADA_MARCA(BANCADA_TESTA_SE_JA_PASSOU);
+		testa_se_ja_passou();
+		BANCADA_MARCA(BANCADA_FIM);
+	}
+}
+
+/* Pior caso: a janela da busca toda visitada, uma serpente de MAPA_JANELA
+ * linhas da partida, num canto, ate a chegada, no fim da ultima linha */
+static void mede_mapa_planeja()
+{
+	int x, y, i, n;
+	int fim = -MAPA_MAX + MAPA_JANELA - 1;
+
+	mapa_limpa();
+	for(y = -MAPA_MAX; y <= fim; y++) {
+		for(x = -MAPA_MAX; x <= fim; x++) {
+			mapa_marca_visitado(x, y);
+			if(x < fim)
+				mapa_poe_saida(x, y, LESTE, MAPA_ABERTA);
+			if(y < fim && x == ((y + MAPA_MAX) & 1 ? -MAPA_MAX : fim))
+				mapa_poe_saida(x, y, NORTE, MAPA_ABERTA);
+		}
+	}
+
+	for(i = 0; i < 10; i++) {
+		BANCADA_MARCA(BANCADA_MAPA_PLANEJA);
+		n = mapa_planeja(-MAPA_MAX, -MAPA_MAX, LESTE, fim, fim,
+						 &path, distancia, 121);
+		BANCADA_MARCA(BANCADA_FIM);
+
+		/* -1 aqui mede uma busca que nem comecou */
+		if(n < 0) {
+			BANCADA_MARCA(BANCADA_FALHOU);
+			while(1);
+		}
+	}
+}
+
+int main()
+{
+	int i;
+
+	pololu_3pi_init(2000);
+
+	/* Calibra com branco e preto para read_line() dar valores de verdade */
+	for(i = 0; i < 10; i++) {
+		BANCADA_PADRAO(i & 1 ? BANCADA_PRETO : BANCADA_BRANCO);
+		calibrate_line_sensors(IR_EMITTERS_ON);
+	}
+
+	BANCADA_PADRAO(BANCADA_LINHA);
+	mede_read_line();
+
+	/* O bancada-sim troca para BANCADA_CRUZAMENTO depois de algumas voltas */
+	follow_segment();
+	BANCADA_MARCA(BANCADA_FIM);
+	set_motors(0, 0);
+
+	mede_simplify_path();
+	mede_testa_se_ja_passou();
+	mede_mapa_planeja();
+
+	BANCADA_MARCA(BANCADA_TERMINOU);
+	while(1);
+}
+
+// Local Variables: **
+// mode: C **
+// c-basic-offset: 4 **
+// tab-width: 4 **
+// indent-tabs-mode: t **
+// end: **
@@ -0,0 +1,222 @@
+/*
+ * bancada-sim.c
+ *
+ * Roda o firmware da bancada (bancada-avr.c) no simavr a 20 MHz e conta
+ * os ciclos entre as marcas de bancada.h.
+ *
+ * Os sensores QTR-RC do 3pi ficam em PC0..PC4: o firmware carrega os
+ * capacitores (pino em saida, nivel alto) e depois solta o pino (entrada)
+ * e mede quanto tempo ele leva para cair. Aqui, quando o pino vira
+ * entrada, ele fica em 1 e cai depois do tempo de descarga do padrao
+ * escolhido pelo firmware em GPIOR1. Os motores (PWM nos timers 0 e 2)
+ * nao precisam de nada: os registradores so sao escritos.
+ *
+ * Uso: ./bancada-sim bancada.elf
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <simavr/sim_avr.h>
+#include <simavr/sim_elf.h>
+#include <simavr/sim_io.h>
+#include <simavr/sim_cycle_timers.h>
+#include <simavr/avr_ioport.h>
+
+#include "bancada.h"
+
+#define F_CPU 20000000UL
+#define CICLOS_POR_TICK 8            /* os tempos do QTR-RC sao em 0.4 us */
+
+/* Enderecos de dados de GPIOR0 e GPIOR1 no atmega328p */
+#define END_GPIOR0 0x3e
+#define END_GPIOR1 0x4a
+
+/* Voltas de follow_segment() antes de aparecer um cruzamento */
+#define VOLTAS_FOLLOW 200
+
+#define N_SENSORES 5
+
+/* Descarga de cada sensor em ticks de 0.4 us, por padrao */
+static const unsigned int descarga[4][N_SENSORES] = {
+	{  150,  150,  150,  150,  150 },   /* BANCADA_BRANCO */
+	{ 1400, 1400, 1400, 1400, 1400 },   /* BANCADA_PRETO */
+	{  150,  400, 1400,  400,  150 },   /* BANCADA_LINHA */
+	{ 1400,  400, 1400,  400, 1400 },   /* BANCADA_CRUZAMENTO */
+};
+
+static const char *const nome_marca[BANCADA_N_MARCAS] = {
+	"",
+	"follow_segment (volta)",
+	"read_line",
+	"simplify_path",
+	"testa_se_ja_passou",
+	"mapa_planeja",
+};
+
+typedef struct Medida {
+	unsigned long chamadas;
+	avr_cycle_count_t total;
+	avr_cycle_count_t minimo;
+	avr_cycle_count_t maximo;
+} Medida;
+
+static Medida medidas[BANCADA_N_MARCAS];
+
+static avr_t *avr;
+static avr_irq_t *pino[N_SENSORES];
+static int padrao = BANCADA_BRANCO;
+static int aberta = BANCADA_FIM;
+static avr_cycle_count_t inicio;
+static int terminou = 0;
+static int falhou = 0;
+
+static avr_cycle_count_t descarrega(avr_t *avr, avr_cycle_count_t quando, void *param)
+{
+	avr_raise_irq((avr_irq_t *)param, 0);
+	return 0;
+}
+
+/* DDRC mudou: os sensores que viraram entrada comecam a descarregar */
+static void direcao(avr_irq_t *irq, uint32_t ddr, void *param)
+{
+	static uint32_t ddr_antes = 0;
+	int i;
+
+	for(i = 0; i < N_SENSORES; i++) {
+		if((ddr_antes & (1 << i)) && !(ddr & (1 << i))) {
+			avr_raise_irq(pino[i], 1);
+			avr_cycle_timer_cancel(avr, descarrega, pino[i]);
+			avr_cycle_timer_register(avr, descarga[padrao][i] * CICLOS_POR_TICK,
+									 descarrega, pino[i]);
+		}
+	}
+
+	ddr_antes = ddr;
+}
+
+static void fecha(avr_cycle_count_t agora)
+{
+	Medida *m;
+	avr_cycle_count_t ciclos;
+
+	if(aberta == BANCADA_FIM)
+		return;
+
+	/* Desconta o "out" da marca que fecha a regiao */
+	m = &medidas[aberta];
+	ciclos = agora - inicio - 1;
+
+	if(!m->chamadas || ciclos < m->minimo)
+		m->minimo = ciclos;
+	if(ciclos > m->maximo)
+		m->maximo = ciclos;
+	m->total += ciclos;
+	m->chamadas++;
+
+	aberta = BANCADA_FIM;
+}
+
+static void marca(avr_t *avr, avr_io_addr_t end, uint8_t valor, void *param)
+{
+	avr->data[end] = valor;
+	fecha(avr->cycle);
+
+	if(valor == BANCADA_TERMINOU || valor == BANCADA_FALHOU) {
+		terminou = 1;
+		falhou = valor == BANCADA_FALHOU;
+		return;
+	}
+
+	if(valor >= BANCADA_N_MARCAS || valor == BANCADA_FIM)
+		return;
+
+	aberta = valor;
+	inicio = avr->cycle;
+
+	if(valor == BANCADA_FOLLOW_SEGMENT && medidas[valor].chamadas == VOLTAS_FOLLOW)
+		padrao = BANCADA_CRUZAMENTO;
+}
+
+static void escolhe_padrao(avr_t *avr, avr_io_addr_t end, uint8_t valor, void *param)
+{
+	avr->data[end] = valor;
+
+	if(valor <= BANCADA_CRUZAMENTO)
+		padrao = valor;
+}
+
+int main(int argc, char **argv)
+{
+	elf_firmware_t firmware;
+	int estado, i;
+
+	if(argc != 2) {
+		fprintf(stderr, "uso: %s bancada.elf\n", argv[0]);
+		return 1;
+	}
+
+	memset(&firmware, 0, sizeof(firmware));
+	if(elf_read_firmware(argv[1], &firmware)) {
+		fprintf(stderr, "%s: nao consegui ler o firmware\n", argv[1]);
+		return 1;
+	}
+
+	avr = avr_make_mcu_by_name("atmega328p");
+	if(!avr) {
+		fprintf(stderr, "simavr sem atmega328p\n");
+		return 1;
+	}
+
+	avr_init(avr);
+	avr_load_firmware(avr, &firmware);
+	avr->frequency = F_CPU;
+
+	for(i = 0; i < N_SENSORES; i++)
+		pino[i] = avr_io_getirq(avr, AVR_IOCTL_IOPORT_GETIRQ('C'), i);
+
+	avr_irq_register_notify(avr_io_getirq(avr, AVR_IOCTL_IOPORT_GETIRQ('C'), IOPORT_IRQ_DIRECTION_ALL),
+							direcao, NULL);
+	avr_register_io_write(avr, END_GPIOR0, marca, NULL);
+	avr_register_io_write(avr, END_GPIOR1, escolhe_padrao, NULL);
+
+	do {
+		estado = avr_run(avr);
+	} while(!terminou && estado != cpu_Done && estado != cpu_Crashed);
+
+	if(!terminou) {
+		fprintf(stderr, "o firmware parou antes do fim (estado %d)\n", estado);
+		return 2;
+	}
+
+	if(falhou) {
+		fprintf(stderr, "o firmware acusou um resultado errado\n");
+		return 2;
+	}
+
+	printf("%-24s %8s %10s %10s %10s %10s\n", "regiao", "chamadas", "min", "media", "max", "media us");
+
+	for(i = 1; i < BANCADA_N_MARCAS; i++) {
+		Medida *m = &medidas[i];
+		double media = m->chamadas ? (double)m->total / m->chamadas : 0;
+
+		printf("%-24s %8lu %10llu %10.0f %10llu %10.1f\n", nome_marca[i], m->chamadas,
+			   (unsigned long long)m->minimo, media, (unsigned long long)m->maximo,
+			   media * 1e6 / F_CPU);
+	}
+
+	if(medidas[BANCADA_FOLLOW_SEGMENT].chamadas) {
+		Medida *m = &medidas[BANCADA_FOLLOW_SEGMENT];
+		printf("\nlaco do PID: %.0f Hz\n", (double)F_CPU * m->chamadas / m->total);
+	}
+
+	return 0;
+}
+
+// Local Variables: **
+// mode: C **
+// c-basic-offset: 4 **
+// tab-width: 4 **
+// indent-tabs-mode: t **
+// end: **
@@ -2,8 +2,7 @@
  * This file is responsible for drawing sensor bar graphs.
  */
 
-#include <pololu/3pi.h>
-#include <avr/pgmspace.h>
+#include "hal.h"
 
 // Data for generating the characters used in load_custom_characters
 // and display_readings.  By reading levels[] starting at various
@@ -0,0 +1,170 @@
+/*
+ * caixa-preta.c
+ *
+ * Um vetor circular de eventos: gravar eh copiar seis bytes e andar um
+ * indice, e a volta do PID que nao eh guardada so decrementa um contador,
+ * entao a caixa preta pode ficar ligada na competicao.
+ */
+
+#include "hal.h"
+#include "caixa-preta.h"
+#include "telemetria.h"
+
+#if CAIXA_PRETA
+
+/* Um evento: tipo 'c' eh uma volta do PID, com a posicao / 16 em 'dados'
+ * e m1 / 2 e m2 / 2 em 'a' e 'b'; senao eh a acao de um cruzamento, com
+ * as saidas vistas em 'dados' (bit 0 esquerda, 1 frente, 2 direita) e x
+ * e y em 'a' e 'b'. */
+typedef struct Evento {
+	unsigned int ms;
+	char tipo;
+	unsigned char dados;
+	signed char a;
+	signed char b;
+} Evento;
+
+static Evento eventos[CAIXA_PRETA];
+static unsigned char proximo;       /* onde vai o proximo evento */
+static unsigned char quantos;
+static unsigned char divisor = 1;
+static unsigned char saidas;
+
+void caixa_preta_limpa()
+{
+	proximo = 0;
+	quantos = 0;
+	divisor = 1;
+}
+
+static Evento *novo(char tipo)
+{
+	Evento *e = &eventos[proximo];
+
+	if(++proximo == CAIXA_PRETA)
+		proximo = 0;
+	if(quantos < CAIXA_PRETA)
+		quantos++;
+
+	e->ms = get_ms();
+	e->tipo = tipo;
+
+	return e;
+}
+
+void caixa_preta_controle(unsigned int posicao, int m1, int m2)
+{
+	Evento *e;
+
+	if(--divisor)
+		return;
+	divisor = CAIXA_PRETA_DIVISOR;
+
+	e = novo('c');
+	e->dados = posicao / 16;
+	e->a = m1 / 2;
+	e->b = m2 / 2;
+}
+
+void caixa_preta_saidas(unsigned char found_left, unsigned char found_straight,
+						unsigned char found_right)
+{
+	saidas = (found_left ? 1 : 0) | (found_straight ? 2 : 0) | (found_right ? 4 : 0);
+}
+
+void caixa_preta_cruzamento(char dir, int x, int y)
+{
+	Evento *e = novo(dir);
+
+	e->dados = saidas;
+	e->a = x;
+	e->b = y;
+}
+
+/* O evento de 'idade' 0 eh o mais novo */
+static Evento *evento(unsigned char idade)
+{
+	int i = (int)proximo - 1 - idade;
+
+	return &eventos[i < 0 ? i + CAIXA_PRETA : i];
+}
+
+/*
+ * Cruzamento:          Volta do PID:
+ *   |3 L <^>|            |3 p1984 |
+ *   |-2,5   |            |60 44   |
+ */
+static void mostra_evento(unsigned char idade)
+{
+	Evento *e = evento(idade);
+
+	clear();
+	print_long(idade);
+
+	if(e->tipo == 'c') {
+		print(" p");
+		print_long(e->dados * 16);
+		lcd_goto_xy(0,1);
+		print_long(e->a * 2);
+		print(" ");
+		print_long(e->b * 2);
+		return;
+	}
+
+	print(" ");
+	print_character(e->tipo);
+	print(" ");
+	print_character(e->dados & 1 ? '<' : '-');
+	print_character(e->dados & 2 ? '^' : '-');
+	print_character(e->dados & 4 ? '>' : '-');
+	lcd_goto_xy(0,1);
+	print_long(e->a);
+	print(",");
+	print_long(e->b);
+}
+
+void caixa_preta_mostra()
+{
+	unsigned char idade = 0;
+
+	wait_for_button_release(BUTTON_C);
+
+	if(!quantos) {
+		clear();
+		print("vazia");
+		wait_for_button(BUTTON_B);
+		return;
+	}
+
+	while(1) {
+		mostra_evento(idade);
+
+		if(wait_for_button(BUTTON_B | BUTTON_C) & BUTTON_B)
+			return;
+
+		if(++idade == quantos)
+			idade = 0;
+	}
+}
+
+void caixa_preta_despeja()
+{
+#ifdef TELEMETRIA
+	unsigned char idade = quantos;
+
+	while(idade--) {
+		Evento *e = evento(idade);
+
+		telemetria_caixa_preta(e->ms, e->tipo, e->dados, e->a, e->b);
+	}
+#endif
+}
+
+#endif
+
+// Local Variables: **
+// mode: C **
+// c-basic-offset: 4 **
+// tab-width: 4 **
+// indent-tabs-mode: t **
+// end: **
@@ -0,0 +1,61 @@
+/*
+ * Caixa preta: os ultimos CAIXA_PRETA eventos da corrida guardados na
+ * SRAM, para ver depois o que aconteceu mesmo sem a serial ligada. Os
+ * eventos sao os cruzamentos (saidas vistas, acao e posicao) e uma volta
+ * do PID a cada CAIXA_PRETA_DIVISOR (posicao da linha e motores).
+ *
+ * Depois da corrida, C mostra a caixa preta no LCD; segurando C enquanto
+ * o robo anda (ex.: ao tira-lo da pista) a corrida acaba ali e ela
+ * aparece, ate o reset. Com
+ * TELEMETRIA ela ainda vai pela serial quando B comeca a proxima corrida.
+ * Compile com CAIXA_PRETA=0 para tira-la.
+ */
+
+#ifndef CAIXA_PRETA_H
+#define CAIXA_PRETA_H
+
+/* Eventos guardados, 6 bytes cada */
+#ifndef CAIXA_PRETA
+#define CAIXA_PRETA 48
+#endif
+
+/* Uma volta do PID guardada a cada tantas (~1 ms cada) */
+#ifndef CAIXA_PRETA_DIVISOR
+#define CAIXA_PRETA_DIVISOR 64
+#endif
+
+#if CAIXA_PRETA
+
+// Esquece a corrida anterior.
+void caixa_preta_limpa();
+
+void caixa_preta_controle(unsigned int posicao, int m1, int m2);
+void caixa_preta_saidas(unsigned char found_left, unsigned char found_straight,
+						unsigned char found_right);
+void caixa_preta_cruzamento(char dir, int x, int y);
+
+// Mostra no LCD, do mais novo para o mais velho: C passa, B sai.
+void caixa_preta_mostra();
+
+// Manda pela serial, do mais velho para o mais novo (so com TELEMETRIA).
+void caixa_preta_despeja();
+
+#else
+
+#define caixa_preta_limpa()
+#define caixa_preta_controle(posicao, m1, m2)
+#define caixa_preta_saidas(found_left, found_straight, found_right)
+#define caixa_preta_cruzamento(dir, x, y)
+#define caixa_preta_mostra()
+#define caixa_preta_despeja()
+
+#endif
+
+#endif
+
+// Local Variables: **
+// mode: C **
+// c-basic-offset: 4 **
+// tab-width: 4 **
+// indent-tabs-mode: t **
+// end: **
@@ -0,0 +1,78 @@
+/*
+ * caminho.c
+ *
+ * O passo i fica nos bits 2*(i%4) e 2*(i%4)+1 do byte i/4. O vetor com um
+ * char por passo gastava TAM_MAPA bytes; assim sao TAM_MAPA / 4.
+ */
+
+#include "hal.h"
+#include "caminho.h"
+
+static const char acoes[4] = { 'S', 'R', 'B', 'L' };
+
+static unsigned char codigo(char dir)
+{
+	unsigned char i;
+
+	for(i = 0; i < 3; i++)
+		if(acoes[i] == dir)
+			break;
+
+	return i;
+}
+
+void caminho_limpa(Caminho *caminho)
+{
+	caminho->n = 0;
+}
+
+char caminho_passo(const Caminho *caminho, unsigned int i)
+{
+	if(i >= caminho->n)
+		return 0;
+
+	return acoes[(caminho->passos[i >> 2] >> ((i & 3) << 1)) & 3];
+}
+
+void caminho_poe(Caminho *caminho, unsigned int i, char dir)
+{
+	unsigned char deslocamento = (i & 3) << 1;
+	unsigned char *byte = &caminho->passos[i >> 2];
+
+	*byte = (*byte & ~(3 << deslocamento)) | (codigo(dir) << deslocamento);
+}
+
+char caminho_acrescenta(Caminho *caminho, char dir)
+{
+	if(caminho->n >= CAMINHO_MAX)
+		return 0;
+
+	caminho_poe(caminho, caminho->n++, dir);
+
+	return 1;
+}
+
+char caminho_tira(Caminho *caminho)
+{
+	if(!caminho->n)
+		return 0;
+
+	caminho->n--;
+
+	return acoes[(caminho->passos[caminho->n >> 2] >> ((caminho->n & 3) << 1)) & 3];
+}
+
+void caminho_texto(const Caminho *caminho, unsigned int inicio, char *texto, unsigned char n)
+{
+	while(n-- && inicio < caminho->n)
+		*texto++ = caminho_passo(caminho, inicio++);
+
+	*texto = 0;
+}
+
+// Local Variables: **
+// mode: C **
+// c-basic-offset: 4 **
+// tab-width: 4 **
+// indent-tabs-mode: t **
+// end: **
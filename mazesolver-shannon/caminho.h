@@ -0,0 +1,48 @@
+/*
+ * Caminho do robo: a acao de cada cruzamento ('S', 'R', 'B' ou 'L') em 2
+ * bits, quatro por byte. O codigo de uma acao eh quantos quartos de volta
+ * ela gira para a direita, como em mapa_planeja(): a soma dos codigos eh
+ * o giro total, o que simplify_path() usa.
+ */
+
+#ifndef CAMINHO_H
+#define CAMINHO_H
+
+#include "mapa.h"
+
+/* Maior numero de passos; o tamanho e os indices sao unsigned int, entao
+ * pode passar de 255 num labirinto maior */
+#define CAMINHO_MAX TAM_MAPA
+#define CAMINHO_BYTES ((CAMINHO_MAX + 3) / 4)
+
+typedef struct Caminho {
+	unsigned char passos[CAMINHO_BYTES];
+	unsigned int n;
+} Caminho;
+
+void caminho_limpa(Caminho *caminho);
+
+// Acao do passo 'i', ou 0 se o caminho nao chega nele.
+char caminho_passo(const Caminho *caminho, unsigned int i);
+
+// Troca a acao do passo 'i', que ja tem que existir.
+void caminho_poe(Caminho *caminho, unsigned int i, char dir);
+
+// Acrescenta um passo no fim; devolve 0 se nao couber.
+char caminho_acrescenta(Caminho *caminho, char dir);
+
+// Tira o ultimo passo e devolve a acao dele (0 se o caminho for vazio).
+char caminho_tira(Caminho *caminho);
+
+// Escreve ate 'n' acoes a partir do passo 'inicio' como texto, terminado
+// em 0; 'texto' precisa de n + 1 chars.
+void caminho_texto(const Caminho *caminho, unsigned int inicio, char *texto, unsigned char n);
+
+#endif
+
+// Local Variables: **
+// mode: C **
+// c-basic-offset: 4 **
+// tab-width: 4 **
+// indent-tabs-mode: t **
+// end: **
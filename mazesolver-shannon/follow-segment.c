@@ -5,74 +5,504 @@
  * 3pi to follow a segment of the maze until it detects an
  * intersection, a dead end, or the finish.
  *
+ * Compilado com -DCONTROLE_HZ=<hz>, o PID roda na interrupcao do timer 1
+ * a uma taxa fixa em vez de rodar tao rapido quanto o laco gira; o
+ * follow_segment() so dorme ate o PID avisar que o segmento acabou. O
+ * timer 1 eh o do buzzer: ele eh devolvido no fim do segmento, mas nada
+ * toca enquanto o robo segue a linha.
  */
 
-#include <pololu/3pi.h>
+#include "hal.h"
+#include "bancada.h"
+#include "follow-segment.h"
+#include "telemetria.h"
+#include "caixa-preta.h"
+#include "ganhos.h"
 
-void follow_segment()
+// The maximum speed and the PID gains by speed (ganhos.h).  Com o PID a
+// taxa fixa da para subir.  No host sao variaveis, para
+// host/ajusta-main.c poder experimentar outros valores sem recompilar.
+#ifdef __AVR__
+static const GanhosVelocidade tabela_ganhos[] PROGMEM = { GANHOS_TABELA };
+#define le_tabela(campo) ((int)pgm_read_word(&(campo)))
+#define velocidade_max VELOCIDADE_MAX
+#else
+GanhosVelocidade tabela_ganhos[] = { GANHOS_TABELA };
+const unsigned char n_ganhos = sizeof(tabela_ganhos) / sizeof(tabela_ganhos[0]);
+#define le_tabela(campo) (campo)
+int velocidade_max = VELOCIDADE_MAX;
+#endif
+#define N_GANHOS (sizeof(tabela_ganhos) / sizeof(tabela_ganhos[0]))
+
+/* Rampas de follow_segment_velocidade(), em unidades de set_motors por ms */
+#define ACELERACAO 1
+#define DESACELERACAO 1
+
+/* Freia para chegar na velocidade final nesta fracao da distancia (%) */
+#define MARGEM_FRENAGEM 90
+
+/* Distancias, em set_motors x ms: ~1 m/s com set_motors(255) da 255 por mm */
+#define UNIDADES_POR_MM 255L
+
+/* Do cruzamento aparecer nos sensores ate as rodas ficarem sobre ele;
+ * eh o que a manobra de 50 ms a 50 e 200 ms a 40 andava */
+#define ATE_AS_RODAS_MM 41
+
+/* Os sensores de fora apagados por isto: ja passamos da fita */
+#define DEPOIS_DA_FITA_MM 4
+
+/* Os tres sensores do meio no escuro por isto eh o quadrado de chegada
+ * (a fita tem 19 mm e o quadrado 60) */
+#define CHEGADA_MM 35
+
+/* Espacamento dos cruzamentos na grade do labirinto */
+#ifndef CELULA_MM
+#define CELULA_MM 150
+#endif
+
+/* Logo depois de um giro o robo ainda balanca sobre a propria fita e os
+ * sensores de fora podem pega-la; o proximo cruzamento so aparece quando
+ * as rodas ja andaram bem mais que isto desde o ultimo */
+#define SEM_CRUZAMENTO_MM (CELULA_MM / 3)
+
+/* Os ganhos abaixo valem por amostra a 1 kHz, a taxa do laco original */
+#ifndef CONTROLE_HZ
+#define PID_HZ 1000L
+#else
+#define PID_HZ ((long)CONTROLE_HZ)
+#endif
+
+static int last_proportional;
+static long integral;
+
+/* Perfil de velocidade do segmento atual */
+static int velocidade_atual;
+static int velocidade_maxima;
+static int velocidade_final;
+static int velocidade_media;        /* das duas rodas, no ultimo comando */
+static long distancia_frenagem;     /* velocidade x ms; 0 = nao freia */
+static long percorrido;             /* velocidade x ms */
+static unsigned long ultimo_ms;
+
+/* Quanto as rodas estavam antes do cruzamento de partida quando o
+ * segmento comecou: 0 depois de um giro, mais quando passou reto */
+static long antes_do_no;
+static long inicio_do_segmento;
+
+static void inicia_segmento(int partida, int maxima, int final, unsigned int distancia)
+{
+	last_proportional = 0;
+	integral = 0;
+
+	velocidade_atual = partida < maxima ? partida : maxima;
+	velocidade_media = velocidade_atual;
+	velocidade_maxima = maxima;
+	velocidade_final = final;
+	distancia_frenagem = (long)distancia * FOLLOW_SEGMENT_UNIDADE / 100 * MARGEM_FRENAGEM;
+	percorrido = 0;
+	ultimo_ms = get_ms();
+
+	inicio_do_segmento = antes_do_no;
+	antes_do_no = 0;
+}
+
+/*
+ * Integra a distancia pelo comando medio das rodas (sem encoder) e escolhe
+ * a velocidade desta volta: acelera ate a maxima e comeca a frear quando
+ * o que falta ate o ponto de frenagem for o necessario para chegar na
+ * velocidade final, v^2 - final^2 = 2 * DESACELERACAO * falta.
+ */
+static int velocidade()
+{
+	unsigned long agora = get_ms();
+	int dt = (int)(agora - ultimo_ms);
+	long falta;
+
+	ultimo_ms = agora;
+	percorrido += (long)velocidade_media * dt;
+	falta = distancia_frenagem - percorrido;
+
+	if(distancia_frenagem && (falta <= 0 ||
+		(long)velocidade_atual * velocidade_atual - (long)velocidade_final * velocidade_final
+		>= 2L * DESACELERACAO * falta)) {
+		velocidade_atual -= DESACELERACAO * dt;
+		if(velocidade_atual < velocidade_final)
+			velocidade_atual = velocidade_final;
+	}
+	else {
+		velocidade_atual += ACELERACAO * dt;
+		if(velocidade_atual > velocidade_maxima)
+			velocidade_atual = velocidade_maxima;
+	}
+
+	return velocidade_atual;
+}
+
+/* Quanto o robo andou desde que o ultimo segmento acabou */
+static long desde_o_fim;
+
+int follow_segment_velocidade_atual()
+{
+	return velocidade_atual;
+}
+
+unsigned int follow_segment_distancia()
+{
+	return (unsigned int)(percorrido / FOLLOW_SEGMENT_UNIDADE);
+}
+
+/* O segmento acaba com os sensores no cruzamento, ATE_AS_RODAS_MM antes
+ * das rodas chegarem nele */
+static unsigned char celulas(long unidades)
+{
+	long mm = unidades / UNIDADES_POR_MM + ATE_AS_RODAS_MM;
+	long n = (mm + CELULA_MM / 2) / CELULA_MM;
+
+	return n < 1 ? 1 : (n > 255 ? 255 : n);
+}
+
+unsigned char follow_segment_celulas()
+{
+	return celulas(inicio_do_segmento + percorrido);
+}
+
+unsigned char follow_segment_celulas_de(unsigned int distancia)
+{
+	return celulas((long)distancia * FOLLOW_SEGMENT_UNIDADE);
+}
+
+unsigned int follow_segment_distancia_de(unsigned char n)
+{
+	return (unsigned int)(((long)n * CELULA_MM - ATE_AS_RODAS_MM) * UNIDADES_POR_MM
+						  / FOLLOW_SEGMENT_UNIDADE);
+}
+
+/* Ganhos da ultima velocidade pedida a ganhos_para() */
+static int ganho_p, ganho_i, ganho_d;
+static int velocidade_dos_ganhos = -1;
+
+/* a + (b - a) * fracao / 256 */
+static int interpola(int a, int b, unsigned int fracao)
+{
+	return a + (int)(((long)(b - a) * fracao) >> 8);
+}
+
+/*
+ * Interpola os ganhos da tabela para a velocidade 'v', em ponto fixo com
+ * 8 bits de fracao; abaixo da primeira linha e acima da ultima valem os
+ * da ponta. So refaz as contas quando a velocidade muda (nas rampas, uma
+ * vez por ms), e ai a unica divisao eh de 16 bits.
+ */
+static void ganhos_para(int v)
+{
+	unsigned char k;
+	int va, vb;
+	unsigned int fracao;
+
+	if(v == velocidade_dos_ganhos)
+		return;
+	velocidade_dos_ganhos = v;
+
+	for(k = 1; k < N_GANHOS - 1 && v > le_tabela(tabela_ganhos[k].velocidade); k++)
+		;
+
+	const GanhosVelocidade *a = &tabela_ganhos[k < N_GANHOS ? k - 1 : 0];
+	const GanhosVelocidade *b = &tabela_ganhos[k < N_GANHOS ? k : 0];
+
+	va = le_tabela(a->velocidade);
+	vb = le_tabela(b->velocidade);
+
+	if(v <= va || vb <= va)
+		fracao = 0;
+	else if(v >= vb)
+		fracao = 256;
+	else
+		fracao = ((unsigned int)(v - va) << 8) / (unsigned int)(vb - va);
+
+	ganho_p = interpola(le_tabela(a->p), le_tabela(b->p), fracao);
+	ganho_i = interpola(le_tabela(a->i), le_tabela(b->i), fracao);
+	ganho_d = interpola(le_tabela(a->d), le_tabela(b->d), fracao);
+}
+
+/* Uma volta do PID; devolve 1 quando o segmento acaba */
+static char passo_pid()
+{
+	BANCADA_MARCA(BANCADA_FOLLOW_SEGMENT);
+
+	// Normally, we will be following a line.  The code below is
+	// similar to the 3pi-linefollower-pid example, but the maximum
+	// speed is turned down to 60 for reliability.
+
+	// Get the position of the line.
+	unsigned int sensors[5];
+	unsigned int position = read_line(sensors,IR_EMITTERS_ON);
+	telemetria_sensores('p', sensors);
+
+	// The "proportional" term should be 0 when we are on the line.
+	int proportional = ((int)position) - 2000;
+
+	// Compute the derivative (change) and integral (sum) of the
+	// position.
+	int derivative = proportional - last_proportional;
+	integral += proportional;
+
+	// Remember the last position.
+	last_proportional = proportional;
+
+	// Compute the difference between the two motor power settings,
+	// m1 - m2.  If this is a positive number the robot will turn
+	// to the left.  If it is a negative number, the robot will
+	// turn to the right, and the magnitude of the number determines
+	// the sharpness of the turn.
+	//
+	// Integral e derivada sao por amostra, entao os ganhos delas
+	// acompanham a taxa (os de ganhos.h valem a 1 kHz).  Os ganhos
+	// dependem da velocidade pedida nesta volta.
+	const int max = velocidade();
+	ganhos_para(max);
+
+	int termo_p = (long)proportional*ganho_p/1000;
+	int termo_i = integral*ganho_i/(1000*PID_HZ);
+	int termo_d = (long)derivative*ganho_d/1000*PID_HZ/1000;
+	int power_difference = termo_p + termo_i + termo_d;
+
+	// Compute the actual motor settings.  We never set either motor
+	// to a negative value.
+	if(power_difference > max)
+		power_difference = max;
+	if(power_difference < -max)
+		power_difference = -max;
+
+	int m1 = max, m2 = max;
+	if(power_difference < 0)
+		m1 = max+power_difference;
+	else
+		m2 = max-power_difference;
+	set_motors(m1,m2);
+
+	telemetria_controle(sensors, position, termo_p, termo_i, termo_d, m1, m2);
+	caixa_preta_controle(position, m1, m2);
+
+	// A roda de dentro anda mais devagar.
+	velocidade_media = max - (power_difference < 0 ? -power_difference : power_difference) / 2;
+
+	if(inicio_do_segmento + percorrido < SEM_CRUZAMENTO_MM * UNIDADES_POR_MM)
+		return 0;
+
+	// We use the inner three sensors (1, 2, and 3) for
+	// determining whether there is a line straight ahead, and the
+	// sensors 0 and 4 for detecting lines going to the left and
+	// right.
+
+	if(sensors[1] < 100 && sensors[2] < 100 && sensors[3] < 100)
+	{
+		// There is no line visible ahead, and we didn't see any
+		// intersection.  Must be a dead end.
+		return 1;
+	}
+	else if(sensors[0] > 200 || sensors[4] > 200)
+	{
+		// Found an intersection.
+		return 1;
+	}
+
+	return 0;
+}
+
+#ifdef CONTROLE_HZ
+
+static volatile char fim_do_segmento;
+
+#ifdef __AVR__
+
+#ifndef F_CPU
+#define F_CPU 20000000UL
+#endif
+
+/* Configuracao do timer 1 deixada pelo buzzer */
+static unsigned char tccr1a, tccr1b, timsk1;
+static unsigned int ocr1a;
+
+static void liga_controle()
+{
+	tccr1a = TCCR1A;
+	tccr1b = TCCR1B;
+	ocr1a = OCR1A;
+	timsk1 = TIMSK1;
+
+	/* CTC com prescaler 8: 2.5 MHz a 20 MHz */
+	TCCR1A = 0;
+	TCCR1B = (1 << WGM12) | (1 << CS11);
+	OCR1A = F_CPU / 8 / CONTROLE_HZ - 1;
+	TCNT1 = 0;
+	TIFR1 = (1 << OCF1A);
+	TIMSK1 = (1 << OCIE1A);
+}
+
+static void desliga_controle()
 {
-	int last_proportional = 0;
-	long integral=0;
+	TIMSK1 = timsk1;
+	TCCR1A = tccr1a;
+	TCCR1B = tccr1b;
+	OCR1A = ocr1a;
+}
+
+/*
+ * read_line() leva centenas de us, entao o PID roda com as interrupcoes
+ * ligadas (o get_ms() da libpololu depende do timer 2), mas sem deixar o
+ * proprio timer 1 entrar de novo: se uma volta atrasar, a proxima so
+ * espera o flag que ficou pendente.
+ */
+ISR(TIMER1_COMPA_vect)
+{
+	TIMSK1 = 0;
+	sei();
+
+	char acabou = passo_pid();
+
+	cli();
+	if(acabou) {
+		desliga_controle();
+		fim_do_segmento = 1;
+	}
+	else {
+		TIMSK1 = (1 << OCIE1A);
+	}
+}
+
+#else
+
+static void desliga_controle()
+{
+	host_interrupcao(0, 0);
+}
+
+static void interrupcao()
+{
+	if(passo_pid()) {
+		desliga_controle();
+		fim_do_segmento = 1;
+	}
+}
+
+static void liga_controle()
+{
+	host_interrupcao(1000000UL / CONTROLE_HZ, interrupcao);
+}
+
+#endif
+
+void follow_segment_velocidade(int partida, int maxima, int final, unsigned int distancia)
+{
+	inicia_segmento(partida, maxima, final, distancia);
+	fim_do_segmento = 0;
+
+	liga_controle();
+
+	// O laco principal so espera o fim do segmento.
+	set_sleep_mode(SLEEP_MODE_IDLE);
+	while(!fim_do_segmento)
+		sleep_mode();
+}
+
+#else
+
+void follow_segment_velocidade(int partida, int maxima, int final, unsigned int distancia)
+{
+	inicia_segmento(partida, maxima, final, distancia);
+
+	while(!passo_pid())
+		;
+}
+
+#endif
+
+/*
+ * Segue reto, na velocidade em que chegou, enquanto passa pelo
+ * cruzamento, juntando o que os sensores veem em cada leitura: os de fora
+ * dizem se ha saida para os lados, os do meio (depois da fita) se ha saida
+ * em frente, e escuro demais nos do meio eh a chegada.
+ */
+char examina_cruzamento(unsigned char *found_left, unsigned char *found_straight, unsigned char *found_right)
+{
+	unsigned int sensors[5];
+	int v = velocidade_atual;
+	unsigned long ultimo = get_ms();
+	long apagado = 0;
+	long escuro = 0;
+
+	*found_left = 0;
+	*found_straight = 0;
+	*found_right = 0;
+	desde_o_fim = 0;
+
+	set_motors(v, v);
 
 	while(1)
 	{
-		// Normally, we will be following a line.  The code below is
-		// similar to the 3pi-linefollower-pid example, but the maximum
-		// speed is turned down to 60 for reliability.
-
-		// Get the position of the line.
-		unsigned int sensors[5];
-		unsigned int position = read_line(sensors,IR_EMITTERS_ON);
-
-		// The "proportional" term should be 0 when we are on the line.
-		int proportional = ((int)position) - 2000;
-
-		// Compute the derivative (change) and integral (sum) of the
-		// position.
-		int derivative = proportional - last_proportional;
-		integral += proportional;
-
-		// Remember the last position.
-		last_proportional = proportional;
-
-		// Compute the difference between the two motor power settings,
-		// m1 - m2.  If this is a positive number the robot will turn
-		// to the left.  If it is a negative number, the robot will
-		// turn to the right, and the magnitude of the number determines
-		// the sharpness of the turn.
-		int power_difference = proportional/20 + integral/10000 + derivative*3/2;
-
-		// Compute the actual motor settings.  We never set either motor
-		// to a negative value.
-		const int max = 60; // the maximum speed
-		if(power_difference > max)
-			power_difference = max;
-		if(power_difference < -max)
-			power_difference = -max;
-		
-		if(power_difference < 0)
-			set_motors(max+power_difference,max);
+		read_line(sensors, IR_EMITTERS_ON);
+		telemetria_sensores('x', sensors);
+
+		unsigned long agora = get_ms();
+		long passo = (long)v * (agora - ultimo);
+		ultimo = agora;
+		desde_o_fim += passo;
+
+		// Check for left and right exits.
+		if(sensors[0] > 100)
+			*found_left = 1;
+		if(sensors[4] > 100)
+			*found_right = 1;
+
+		if(sensors[1] > 600 && sensors[2] > 600 && sensors[3] > 600)
+			escuro += passo;
+		else
+			escuro = 0;
+
+		if(escuro >= CHEGADA_MM * UNIDADES_POR_MM)
+			return 1;
+
+		if(sensors[0] > 100 || sensors[4] > 100)
+			apagado = 0;
 		else
-			set_motors(max,max-power_difference);
-
-		// We use the inner three sensors (1, 2, and 3) for
-		// determining whether there is a line straight ahead, and the
-		// sensors 0 and 4 for detecting lines going to the left and
-		// right.
-
-		if(sensors[1] < 100 && sensors[2] < 100 && sensors[3] < 100)
-		{
-			// There is no line visible ahead, and we didn't see any
-			// intersection.  Must be a dead end.
-			return;
-		}
-		else if(sensors[0] > 200 || sensors[4] > 200)
-		{
-			// Found an intersection.
-			return;
-		}
+			apagado += passo;
 
+		if(apagado >= DEPOIS_DA_FITA_MM * UNIDADES_POR_MM ||
+		   desde_o_fim >= ATE_AS_RODAS_MM * UNIDADES_POR_MM)
+			break;
 	}
+
+	// Check for a straight exit.
+	if(sensors[1] > 200 || sensors[2] > 200 || sensors[3] > 200)
+		*found_straight = 1;
+
+	// Se seguir reto, o proximo segmento comeca com as rodas aqui.
+	antes_do_no = ATE_AS_RODAS_MM * UNIDADES_POR_MM - desde_o_fim;
+
+	telemetria_saidas(*found_left, *found_straight, *found_right);
+	caixa_preta_saidas(*found_left, *found_straight, *found_right);
+
+	return 0;
+}
+
+void alinha_no_cruzamento()
+{
+	long falta = ATE_AS_RODAS_MM * UNIDADES_POR_MM - desde_o_fim;
+	int v = velocidade_atual;
+
+	if(v > velocidade_max)
+		v = velocidade_max;
+
+	set_motors(v, v);
+	if(falta > 0)
+		delay_ms(falta / v);
+
+	antes_do_no = 0;
+}
+
+void follow_segment()
+{
+	follow_segment_velocidade(velocidade_max, velocidade_max, velocidade_max, 0);
 }
 
 // Local Variables: **
@@ -1 +1,51 @@
+#ifndef FOLLOW_SEGMENT_H
+#define FOLLOW_SEGMENT_H
+
 void follow_segment();
+
+// Uma linha da tabela de ganhos do PID por velocidade (ganhos.h).
+typedef struct GanhosVelocidade {
+	int velocidade;
+	int p;
+	int i;
+	int d;
+} GanhosVelocidade;
+
+#ifndef __AVR__
+// Os valores de ganhos.h, que o host pode trocar antes da corrida.
+extern GanhosVelocidade tabela_ganhos[];
+extern const unsigned char n_ganhos;
+extern int velocidade_max;
+#endif
+
+// Segue o segmento acelerando de 'partida' ate 'maxima' (unidades de
+// set_motors); follow_segment() usa a velocidade maxima de sempre. Se
+// 'distancia' nao for 0, freia para chegar ao fim dela em 'final'.
+void follow_segment_velocidade(int partida, int maxima, int final, unsigned int distancia);
+
+// Velocidade com que o ultimo segmento acabou, a mesma com que
+// examina_cruzamento() passa pelo cruzamento: quem segue reto pode sair
+// nela no proximo segmento.
+int follow_segment_velocidade_atual();
+
+// Distancia do ultimo segmento, estimada pelos comandos de velocidade,
+// em unidades de set_motors x ms / FOLLOW_SEGMENT_UNIDADE.
+#define FOLLOW_SEGMENT_UNIDADE 64
+unsigned int follow_segment_distancia();
+
+// Quantas celulas da grade do labirinto tem o ultimo segmento, de
+// cruzamento a cruzamento; ou um segmento de 'distancia' (como acima)
+// comecado com as rodas no cruzamento. follow_segment_distancia_de() eh
+// a distancia esperada para um segmento de 'n' celulas.
+unsigned char follow_segment_celulas();
+unsigned char follow_segment_celulas_de(unsigned int distancia);
+unsigned int follow_segment_distancia_de(unsigned char n);
+
+// Depois do follow_segment(): passa pelo cruzamento sem parar e diz que
+// saidas ele tem; devolve 1 se for o quadrado de chegada.
+char examina_cruzamento(unsigned char *found_left, unsigned char *found_straight, unsigned char *found_right);
+
+// Anda o que falta para as rodas ficarem sobre o cruzamento, para girar.
+void alinha_no_cruzamento();
+
+#endif
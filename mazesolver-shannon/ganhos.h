@@ -0,0 +1,42 @@
+/*
+ * Ganhos do PID de follow_segment() por velocidade e a velocidade maxima.
+ *
+ * host/ajusta-main.c (make ajusta) procura ganhos melhores no simulador
+ * e escreve um arquivo igual a este; os valores daqui sao os escolhidos
+ * a mao, pela confiabilidade. Os ganhos valem por amostra a 1 kHz (ver
+ * PID_HZ em follow-segment.c), e as opcoes do Makefile passam na frente.
+ */
+
+#ifndef GANHOS_H
+#define GANHOS_H
+
+/*
+ * Uma linha por velocidade (unidades de set_motors), em ordem crescente:
+ * { velocidade, GANHO_P, GANHO_I, GANHO_D }, com
+ *   termo_p = proportional * GANHO_P / 1000
+ *   termo_i = integral * GANHO_I / 1000000
+ *   termo_d = derivative * GANHO_D / 1000
+ * Entre duas linhas os ganhos sao interpolados pela velocidade pedida;
+ * abaixo da primeira e acima da ultima valem os da ponta. Com o mesmo
+ * D, o amortecimento cresce com a velocidade, entao a linha da reta das
+ * repeticoes (120) tem metade do D.
+ */
+#ifndef GANHOS_TABELA
+#define GANHOS_TABELA \
+	{  40, 50, 100, 1500 }, \
+	{  60, 50, 100, 1500 }, \
+	{ 120, 50, 100,  750 }
+#endif
+
+#ifndef VELOCIDADE_MAX
+#define VELOCIDADE_MAX 60
+#endif
+
+#endif
+
+// Local Variables: **
+// mode: C **
+// c-basic-offset: 4 **
+// tab-width: 4 **
+// indent-tabs-mode: t **
+// end: **
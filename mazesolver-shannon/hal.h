@@ -0,0 +1,34 @@
+/*
+ * Camada de abstracao de hardware (HAL).
+ *
+ * O resolvedor chama a libpololu diretamente (read_line, set_motors,
+ * delay_ms, print, play, button_is_pressed...). Todo arquivo inclui este
+ * header no lugar de <pololu/3pi.h>: no 3pi as funcoes vem da propria
+ * libpololu, e no build de host (make host) vem de host/hal-host.c, de
+ * forma que o mesmo codigo roda sem alteracoes no Linux.
+ */
+
+#ifdef __AVR__
+
+#include <pololu/3pi.h>
+#include <avr/pgmspace.h>
+#include <avr/interrupt.h>
+#include <avr/sleep.h>
+#include <avr/eeprom.h>
+
+#else
+
+#include "host/hal-host.h"
+
+#endif
+
+/* O resolvedor nao usa o heap: toda a memoria eh estatica ou de pilha,
+ * para caber sempre nos 2 KB do atmega328p */
+#pragma GCC poison malloc calloc realloc free
+
+// Local Variables: **
+// mode: C **
+// c-basic-offset: 4 **
+// tab-width: 4 **
+// indent-tabs-mode: t **
+// end: **
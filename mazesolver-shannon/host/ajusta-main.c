@@ -0,0 +1,536 @@
+/*
+ * ajusta-main.c
+ *
+ * Procura os ganhos do PID de cada linha da tabela por velocidade e a
+ * velocidade maxima de follow_segment() (ganhos.h) que dao as corridas
+ * mais rapidas num corpus de labirintos, e escreve um ganhos.h com os
+ * melhores. As velocidades das linhas ficam como estao.
+ *
+ * Cada candidato eh pontuado pela media, nos labirintos, do tempo das
+ * duas corridas (aprendizado e repeticao) mais 'penalidade' segundos por
+ * segundo seguindo segmento fora da linha (ver corrida.c); um labirinto
+ * que falha vale PENALIDADE_FALHA_S. A busca eh por coordenadas: a partir
+ * dos valores compilados, cada rodada experimenta cada parametro
+ * multiplicado e dividido por 1 + passo e fica com o melhor candidato;
+ * quando nenhum melhora, o passo cai pela metade, ate PASSO_MINIMO. Com
+ * -x um parametro fica fixo: P60, I60 e D60 sao os ganhos da linha de
+ * velocidade 60, e VELOCIDADE_MAX a velocidade.
+ *
+ * Como no main-lote, cada labirinto de cada candidato roda num processo
+ * filho, e os candidatos de uma rodada dividem as mesmas vagas, entao
+ * todos os nucleos ficam ocupados mesmo com poucos labirintos.
+ *
+ * Uso: ./main-ajusta [-j processos] [-s semente] [-t limite_s] [-p penalidade]
+ *                    [-r rodadas] [-x parametro]... [-o ganhos.h]
+ *                    corpus.labs|labirinto.txt...
+ *
+ * Sem -o o ganhos.h vai para a saida padrao; o progresso vai para stderr.
+ * Sao 8 rodadas se -r nao disser outra coisa; cada uma custa uns 3 s de
+ * CPU por labirinto do corpus, divididos entre os -j processos.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+
+#include "corrida.h"
+#include "follow-segment.h"
+
+#define N_CORRIDAS 2          /* aprendizado e repeticao */
+#define LIMITE_REAL_S 10      /* tempo de parede maximo de um labirinto */
+#define PENALIDADE_FALHA_S 600.0
+#define PASSO_INICIAL 0.5
+#define PASSO_MINIMO 0.05
+
+/* Os ganhos de cada linha da tabela e a velocidade maxima */
+#define MAX_PARAMETROS 64
+
+typedef struct Parametro {
+	char nome[16];
+	int *valor;               /* a variavel de follow-segment.c */
+	int minimo;
+	int maximo;
+	int fixo;
+} Parametro;
+
+static Parametro parametros[MAX_PARAMETROS];
+static int n_parametros = 0;
+
+typedef struct Candidato {
+	int valor[MAX_PARAMETROS];
+	double pontuacao;
+	double tempo_s;           /* media das duas corridas, so dos resolvidos */
+	double fora_s;            /* idem, fora da linha */
+	int falhas;
+} Candidato;
+
+static void parametro(const char *prefixo, int velocidade, int *valor, int minimo, int maximo)
+{
+	Parametro *p = &parametros[n_parametros++];
+
+	if(velocidade >= 0)
+		snprintf(p->nome, sizeof(p->nome), "%s%d", prefixo, velocidade);
+	else
+		snprintf(p->nome, sizeof(p->nome), "%s", prefixo);
+	p->valor = valor;
+	p->minimo = minimo;
+	p->maximo = maximo;
+	p->fixo = 0;
+}
+
+static void monta_parametros()
+{
+	int k;
+
+	for(k = 0; k < n_ganhos && 3 * k + 4 <= MAX_PARAMETROS; k++) {
+		GanhosVelocidade *g = &tabela_ganhos[k];
+
+		parametro("P", g->velocidade, &g->p, 1, 1000);
+		parametro("I", g->velocidade, &g->i, 0, 1000);   /* integral * I num long do AVR */
+		parametro("D", g->velocidade, &g->d, 0, 10000);
+	}
+
+	parametro("VELOCIDADE_MAX", -1, &velocidade_max, 20, 255);
+}
+
+static int fixa(const char *nome)
+{
+	int k;
+
+	for(k = 0; k < n_parametros; k++) {
+		if(!strcmp(parametros[k].nome, nome)) {
+			parametros[k].fixo = 1;
+			return 0;
+		}
+	}
+
+	fprintf(stderr, "parametro desconhecido: %s\n", nome);
+	return -1;
+}
+
+static Labirinto *labirintos = NULL;
+static int n_labirintos = 0;
+
+/* Candidatos ja avaliados: a busca volta muito ao mesmo ponto */
+static Candidato *avaliados = NULL;
+static int n_avaliados = 0;
+
+static void *cresce(void *vetor, int n, int *cabem, size_t tamanho)
+{
+	if(n < *cabem)
+		return vetor;
+
+	*cabem = *cabem ? 2 * *cabem : 64;
+	vetor = realloc(vetor, *cabem * tamanho);
+	if(!vetor) {
+		perror("realloc");
+		exit(1);
+	}
+
+	return vetor;
+}
+
+/* Le um labirinto texto ou todos os registros de um corpus binario */
+static int carrega(const char *arquivo)
+{
+	static int cabem = 0;
+	FILE *f = fopen(arquivo, "rb");
+	int binario, lidos;
+
+	if(!f) {
+		perror(arquivo);
+		return -1;
+	}
+
+	binario = fgetc(f) == 'L' && fgetc(f) == 'B';
+	rewind(f);
+
+	if(!binario) {
+		fclose(f);
+		labirintos = cresce(labirintos, n_labirintos, &cabem, sizeof(Labirinto));
+		if(lab_le(&labirintos[n_labirintos], arquivo))
+			return -1;
+		n_labirintos++;
+		return 0;
+	}
+
+	while(1) {
+		labirintos = cresce(labirintos, n_labirintos, &cabem, sizeof(Labirinto));
+		lidos = lab_le_binario(f, &labirintos[n_labirintos]);
+		if(lidos != 1)
+			break;
+		n_labirintos++;
+	}
+
+	fclose(f);
+
+	if(lidos < 0) {
+		fprintf(stderr, "%s: registro invalido\n", arquivo);
+		return -1;
+	}
+
+	return 0;
+}
+
+/* Processo filho: roda um labirinto com os valores do candidato */
+static void roda(const Candidato *c, int lab, Resultado *res, unsigned long semente,
+				 double limite_s)
+{
+	int k;
+
+	signal(SIGALRM, SIG_DFL);
+	alarm(LIMITE_REAL_S);
+
+	if(!freopen("/dev/null", "w", stderr))
+		_exit(2);
+
+	for(k = 0; k < n_parametros; k++)
+		*parametros[k].valor = c->valor[k];
+
+	corrida_roda(&labirintos[lab], semente + lab, N_CORRIDAS, limite_s, res, NULL);
+	_exit(2);
+}
+
+static void pontua(Candidato *c, const Resultado *res, double penalidade)
+{
+	double soma = 0;
+	int i, ok = 0;
+
+	c->tempo_s = 0;
+	c->fora_s = 0;
+	c->falhas = 0;
+
+	for(i = 0; i < n_labirintos; i++) {
+		const Resultado *r = &res[i];
+		double tempo_s, fora_s;
+
+		if(r->falha != CORRIDA_OK || r->corridas < N_CORRIDAS) {
+			c->falhas++;
+			soma += PENALIDADE_FALHA_S;
+			continue;
+		}
+
+		tempo_s = r->tempo_s[0] + r->tempo_s[1];
+		fora_s = r->fora_da_linha_s[0] + r->fora_da_linha_s[1];
+
+		soma += tempo_s + penalidade * fora_s;
+		c->tempo_s += tempo_s;
+		c->fora_s += fora_s;
+		ok++;
+	}
+
+	c->pontuacao = soma / n_labirintos;
+	if(ok) {
+		c->tempo_s /= ok;
+		c->fora_s /= ok;
+	}
+}
+
+/* Pontua os 'n' candidatos, todos os labirintos de todos nas mesmas vagas */
+static void avalia(Candidato *cands, int n, int processos, unsigned long semente,
+				   double limite_s, double penalidade)
+{
+	int trabalhos = n * n_labirintos;
+	Resultado *res;
+	pid_t *pids;
+	int *rodando_em;
+	int proximo = 0, rodando = 0, i, status;
+
+	res = mmap(NULL, trabalhos * sizeof(Resultado), PROT_READ | PROT_WRITE,
+			   MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	pids = calloc(processos, sizeof(pid_t));
+	rodando_em = calloc(processos, sizeof(int));
+	if(res == MAP_FAILED || !pids || !rodando_em) {
+		perror("mmap");
+		exit(1);
+	}
+	memset(res, 0, trabalhos * sizeof(Resultado));
+
+	while(proximo < trabalhos || rodando) {
+		pid_t pid;
+		int vaga;
+
+		for(vaga = 0; vaga < processos && proximo < trabalhos; vaga++) {
+			if(pids[vaga])
+				continue;
+
+			fflush(NULL);
+			pid = fork();
+			if(pid < 0) {
+				perror("fork");
+				exit(1);
+			}
+			if(pid == 0)
+				roda(&cands[proximo / n_labirintos], proximo % n_labirintos, &res[proximo],
+					 semente, limite_s);
+
+			pids[vaga] = pid;
+			rodando_em[vaga] = proximo;
+			proximo++;
+			rodando++;
+		}
+
+		pid = wait(&status);
+		if(pid < 0) {
+			perror("wait");
+			exit(1);
+		}
+
+		for(vaga = 0; vaga < processos && pids[vaga] != pid; vaga++)
+			;
+		if(vaga == processos)
+			continue;
+
+		pids[vaga] = 0;
+		rodando--;
+
+		/* Morto por sinal (ex.: o alarme): o resultado nao vale */
+		if(WIFSIGNALED(status))
+			res[rodando_em[vaga]].falha = CORRIDA_RESOLVEDOR_TERMINOU;
+	}
+
+	for(i = 0; i < n; i++)
+		pontua(&cands[i], &res[i * n_labirintos], penalidade);
+
+	munmap(res, trabalhos * sizeof(Resultado));
+	free(pids);
+	free(rodando_em);
+}
+
+static Candidato *procura(const int *valor)
+{
+	int i;
+
+	for(i = 0; i < n_avaliados; i++)
+		if(!memcmp(avaliados[i].valor, valor, sizeof(avaliados[i].valor)))
+			return &avaliados[i];
+
+	return NULL;
+}
+
+/* Avalia os candidatos que ainda nao foram e guarda no cache */
+static void avalia_novos(Candidato *cands, int n, int processos, unsigned long semente,
+						 double limite_s, double penalidade)
+{
+	static int cabem = 0;
+	Candidato novos[2 * MAX_PARAMETROS + 1];
+	int i, n_novos = 0;
+
+	for(i = 0; i < n; i++)
+		if(!procura(cands[i].valor))
+			novos[n_novos++] = cands[i];
+
+	if(n_novos)
+		avalia(novos, n_novos, processos, semente, limite_s, penalidade);
+
+	for(i = 0; i < n_novos; i++) {
+		avaliados = cresce(avaliados, n_avaliados, &cabem, sizeof(Candidato));
+		avaliados[n_avaliados++] = novos[i];
+	}
+
+	for(i = 0; i < n; i++)
+		cands[i] = *procura(cands[i].valor);
+}
+
+/* O vizinho de 'c' com o parametro k vezes ou dividido por 1 + passo;
+ * 0 se sair dos limites ou nao mudar */
+static int vizinho(const Candidato *c, int k, int sobe, double passo, Candidato *v)
+{
+	const Parametro *p = &parametros[k];
+	int valor = c->valor[k];
+
+	if(p->fixo)
+		return 0;
+	int novo = (int)((sobe ? valor * (1 + passo) : valor / (1 + passo)) + 0.5);
+
+	/* Um passo pequeno pode arredondar para o mesmo valor */
+	if(novo == valor)
+		novo += sobe ? 1 : -1;
+
+	if(novo < p->minimo || novo > p->maximo)
+		return 0;
+
+	*v = *c;
+	v->valor[k] = novo;
+	return 1;
+}
+
+static void mostra(FILE *f, const char *prefixo, const Candidato *c)
+{
+	int k;
+
+	fprintf(f, "%s", prefixo);
+	for(k = 0; k < n_parametros; k++)
+		if(!parametros[k].fixo)
+			fprintf(f, " %s=%d", parametros[k].nome, c->valor[k]);
+	fprintf(f, ": %.3f (%.2f s, %.3f s fora da linha, %d falhas)\n",
+			c->pontuacao, c->tempo_s, c->fora_s, c->falhas);
+}
+
+static void escreve_ganhos(FILE *f, const Candidato *c, const Candidato *inicial,
+						   double penalidade)
+{
+	int k, linhas = (n_parametros - 1) / 3;
+
+	fprintf(f, "/*\n"
+			" * Ganhos do PID de follow_segment() por velocidade e a velocidade maxima.\n"
+			" *\n"
+			" * Gerado por host/ajusta-main.c em %d labirintos, penalidade %g por\n"
+			" * segundo fora da linha: pontuacao %.3f (era %.3f), %.2f s nas\n"
+			" * duas corridas, %.3f s fora da linha, %d falhas. Os ganhos valem\n"
+			" * por amostra a 1 kHz (ver PID_HZ em follow-segment.c), e as opcoes\n"
+			" * do Makefile passam na frente.\n"
+			" */\n\n"
+			"#ifndef GANHOS_H\n"
+			"#define GANHOS_H\n\n",
+			n_labirintos, penalidade, c->pontuacao, inicial->pontuacao, c->tempo_s,
+			c->fora_s, c->falhas);
+
+	fprintf(f, "/*\n"
+			" * Uma linha por velocidade (unidades de set_motors), em ordem crescente:\n"
+			" * { velocidade, GANHO_P, GANHO_I, GANHO_D }, com\n"
+			" *   termo_p = proportional * GANHO_P / 1000\n"
+			" *   termo_i = integral * GANHO_I / 1000000\n"
+			" *   termo_d = derivative * GANHO_D / 1000\n"
+			" * Entre duas linhas os ganhos sao interpolados pela velocidade pedida;\n"
+			" * abaixo da primeira e acima da ultima valem os da ponta.\n"
+			" */\n"
+			"#ifndef GANHOS_TABELA\n"
+			"#define GANHOS_TABELA");
+
+	for(k = 0; k < linhas; k++)
+		fprintf(f, "%s \\\n\t{ %3d, %d, %d, %d }", k ? "," : "", tabela_ganhos[k].velocidade,
+				c->valor[3 * k], c->valor[3 * k + 1], c->valor[3 * k + 2]);
+
+	fprintf(f, "\n#endif\n\n"
+			"#ifndef VELOCIDADE_MAX\n"
+			"#define VELOCIDADE_MAX %d\n"
+			"#endif\n\n"
+			"#endif\n\n"
+			"// Local Variables: **\n"
+			"// mode: C **\n"
+			"// c-basic-offset: 4 **\n"
+			"// tab-width: 4 **\n"
+			"// indent-tabs-mode: t **\n"
+			"// end: **\n", c->valor[n_parametros - 1]);
+}
+
+int main(int argc, char **argv)
+{
+	unsigned long semente = 1;
+	double limite_s = 600, penalidade = 10, passo = PASSO_INICIAL;
+	int processos = (int)sysconf(_SC_NPROCESSORS_ONLN);
+	int rodadas = 8, rodada, opcao, i, k;
+	const char *saida = NULL;
+	Candidato atual, inicial;
+	FILE *f;
+
+	monta_parametros();
+
+	while((opcao = getopt(argc, argv, "j:s:t:p:r:x:o:")) != -1) {
+		switch(opcao) {
+		case 'j':
+			processos = atoi(optarg);
+			break;
+		case 's':
+			semente = strtoul(optarg, NULL, 0);
+			break;
+		case 't':
+			limite_s = atof(optarg);
+			break;
+		case 'p':
+			penalidade = atof(optarg);
+			break;
+		case 'r':
+			rodadas = atoi(optarg);
+			break;
+		case 'x':
+			if(fixa(optarg))
+				return 1;
+			break;
+		case 'o':
+			saida = optarg;
+			break;
+		default:
+			optind = argc;
+			break;
+		}
+	}
+
+	if(optind == argc || processos < 1) {
+		fprintf(stderr, "uso: %s [-j processos] [-s semente] [-t limite_s] [-p penalidade] "
+				"[-r rodadas] [-x parametro]... [-o ganhos.h] corpus.labs|labirinto.txt...\n", argv[0]);
+		return 1;
+	}
+
+	for(i = optind; i < argc; i++)
+		if(carrega(argv[i]))
+			return 1;
+
+	if(!n_labirintos) {
+		fprintf(stderr, "nenhum labirinto\n");
+		return 1;
+	}
+
+	memset(&atual, 0, sizeof(atual));
+	for(k = 0; k < n_parametros; k++)
+		atual.valor[k] = *parametros[k].valor;
+
+	avalia_novos(&atual, 1, processos, semente, limite_s, penalidade);
+	inicial = atual;
+	mostra(stderr, "inicial:", &atual);
+
+	for(rodada = 1; rodada <= rodadas && passo >= PASSO_MINIMO; rodada++) {
+		Candidato vizinhos[2 * MAX_PARAMETROS];
+		const Candidato *melhor = &atual;
+		char prefixo[64];
+		int n = 0;
+
+		for(k = 0; k < n_parametros; k++) {
+			n += vizinho(&atual, k, 1, passo, &vizinhos[n]);
+			n += vizinho(&atual, k, 0, passo, &vizinhos[n]);
+		}
+
+		avalia_novos(vizinhos, n, processos, semente, limite_s, penalidade);
+
+		for(i = 0; i < n; i++)
+			if(vizinhos[i].pontuacao < melhor->pontuacao)
+				melhor = &vizinhos[i];
+
+		if(melhor == &atual)
+			passo /= 2;
+		else
+			atual = *melhor;
+
+		snprintf(prefixo, sizeof(prefixo), "rodada %d (passo %.3f):", rodada, passo);
+		mostra(stderr, prefixo, &atual);
+	}
+
+	if(saida) {
+		f = fopen(saida, "w");
+		if(!f) {
+			perror(saida);
+			return 1;
+		}
+	}
+	else {
+		f = stdout;
+	}
+
+	escreve_ganhos(f, &atual, &inicial, penalidade);
+	if(f != stdout)
+		fclose(f);
+
+	return 0;
+}
+
+// Local Variables: **
+// mode: C **
+// c-basic-offset: 4 **
+// tab-width: 4 **
+// indent-tabs-mode: t **
+// end: **
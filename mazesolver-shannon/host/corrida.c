@@ -0,0 +1,207 @@
+/*
+ * corrida.c
+ *
+ * O operador virtual aperta B sempre que o robo espera: a cada aperto o
+ * robo eh recolocado na largada, como fazemos na pista. Uma corrida vai
+ * do primeiro comando de motor depois do aperto ate o robo parar sobre o
+ * quadrado de chegada.
+ *
+ * Cruzamentos e curvas sao contados interceptando follow_segment(),
+ * follow_segment_velocidade() e turn() na ligacao (-Wl,--wrap), sem
+ * mexer no resolvedor. Enquanto o robo segue um segmento, o tempo com o
+ * sensor do meio fora da fita conta como fora da linha.
+ */
+
+#include <math.h>
+#include <string.h>
+
+#include "hal-host.h"
+#include "corrida.h"
+#include "sim.h"
+#include "caminho.h"
+
+int solver_main();
+void define_saida(int x, int y);
+
+/* Estado do resolvedor (main.c) */
+extern Caminho path;
+
+const char *const corrida_nome_falha[] = {
+	"ok",
+	"saiu da pista",
+	"tempo esgotado",
+	"o resolvedor terminou"
+};
+
+static Labirinto *lab;
+static Sim sim;
+static Resultado *res;
+static void (*relata)(const Resultado *res);
+
+int corrida_conta_saida = 0;
+
+static int n_corridas;
+static double limite_s;
+
+/* Marcas da corrida atual, em us de tempo virtual; 0 = ainda nao */
+static unsigned long long partida_us = 0;
+static unsigned long long parada_us = 0;
+
+static int seguindo = 0;    /* dentro de follow_segment() */
+
+static void termina(int falha)
+{
+	res->falha = falha;
+	res->falha_s = falha ? host_tempo_us() / 1e6 : 0;
+
+	if(relata)
+		relata(res);
+
+	host_termina(falha ? 2 : 0);
+}
+
+static void motores(int m1, int m2)
+{
+	sim_motores(&sim, m1, m2);
+
+	if((m1 || m2) && !partida_us) {
+		partida_us = host_tempo_us();
+		parada_us = 0;
+	}
+	else if(!m1 && !m2 && partida_us && !parada_us && sim_na_chegada(&sim)) {
+		parada_us = host_tempo_us();
+	}
+}
+
+static void sensores(unsigned int *brutos, unsigned int timeout)
+{
+	sim_sensores(&sim, brutos, timeout);
+}
+
+static void avanca(unsigned long us)
+{
+	sim_avanca(&sim, us);
+
+	if(seguindo && partida_us && res->corridas < CORRIDA_MAX) {
+		double x = sim.robo.x + SIM_SENSOR_FRENTE_MM * cos(sim.robo.th);
+		double y = sim.robo.y + SIM_SENSOR_FRENTE_MM * sin(sim.robo.th);
+
+		if(sim_cobertura(lab, x, y) == 0)
+			res->fora_da_linha_s[res->corridas] += us / 1e6;
+	}
+
+	if(sim_fora_da_pista(&sim))
+		termina(CORRIDA_FORA_DA_PISTA);
+
+	if(partida_us && host_tempo_us() - partida_us > limite_s * 1e6)
+		termina(CORRIDA_TEMPO_ESGOTADO);
+}
+
+static void botao(unsigned char botoes)
+{
+	(void)botoes;
+
+	if(partida_us && parada_us) {
+		res->tempo_s[res->corridas] = (parada_us - partida_us) / 1e6;
+		res->path_length[res->corridas] = path.n;
+		res->corridas++;
+
+		if(res->corridas == n_corridas)
+			termina(CORRIDA_OK);
+
+		/* A pista muda depois da corrida de aprendizado */
+		if(res->corridas == 1)
+			lab_aplica_mudancas(lab);
+	}
+
+	/* Recoloca o robo na largada para a proxima corrida */
+	sim_coloca_na_largada(&sim);
+	partida_us = 0;
+	parada_us = 0;
+	res->cruzamentos[res->corridas] = 0;
+	res->curvas[res->corridas] = 0;
+	res->fora_da_linha_s[res->corridas] = 0;
+}
+
+static const PlantaHost planta_sim = {
+	motores,
+	sensores,
+	avanca,
+	botao
+};
+
+void __real_follow_segment();
+void __real_follow_segment_velocidade(int partida, int maxima, int final, unsigned int distancia);
+void __real_turn(char dir);
+
+static void conta_cruzamento()
+{
+	if(res && res->corridas < CORRIDA_MAX)
+		res->cruzamentos[res->corridas]++;
+}
+
+void __wrap_follow_segment()
+{
+	seguindo = 1;
+	__real_follow_segment();
+	seguindo = 0;
+	conta_cruzamento();
+}
+
+void __wrap_follow_segment_velocidade(int partida, int maxima, int final, unsigned int distancia)
+{
+	seguindo = 1;
+	__real_follow_segment_velocidade(partida, maxima, final, distancia);
+	seguindo = 0;
+	conta_cruzamento();
+}
+
+void __wrap_turn(char dir)
+{
+	if(res && res->corridas < CORRIDA_MAX && dir != 'S')
+		res->curvas[res->corridas]++;
+
+	__real_turn(dir);
+}
+
+/* A chegada nas coordenadas do robo: celulas a partir da largada, com y
+ * para onde ele sai */
+static void conta_saida()
+{
+	int x = lab->x_fim - lab->x_inicio;
+	int y = lab->y_fim - lab->y_inicio;
+	int frente = lab->dir_inicio, direita = (lab->dir_inicio + 1) & 3;
+
+	define_saida(x * lab_dx[direita] + y * lab_dy[direita],
+				 x * lab_dx[frente] + y * lab_dy[frente]);
+}
+
+void corrida_roda(Labirinto *l, unsigned long semente, int n, double limite,
+				  Resultado *r, void (*f)(const Resultado *res))
+{
+	lab = l;
+	res = r;
+	relata = f;
+	n_corridas = n;
+	limite_s = limite;
+
+	memset(res, 0, sizeof(*res));
+
+	sim_inicia(&sim, lab, semente);
+	host_usa_planta(&planta_sim);
+
+	if(corrida_conta_saida)
+		conta_saida();
+
+	solver_main();
+
+	/* O main() do robo nunca deveria voltar */
+	termina(CORRIDA_RESOLVEDOR_TERMINOU);
+}
+
+// Local Variables: **
+// mode: C **
+// c-basic-offset: 4 **
+// tab-width: 4 **
+// indent-tabs-mode: t **
+// end: **
@@ -0,0 +1,58 @@
+/*
+ * Corridas do resolvedor sobre o simulador.
+ *
+ * Liga o simulador a HAL de host como planta e faz o papel do operador:
+ * aperta B sempre que o robo espera, recoloca o robo na largada e mede
+ * cada corrida. Usado por main-sim (um labirinto) e main-lote (corpus).
+ */
+
+#ifndef CORRIDA_H
+#define CORRIDA_H
+
+#include "labirinto.h"
+
+#define CORRIDA_MAX 16
+
+/* Como o processo terminou */
+#define CORRIDA_OK 0
+#define CORRIDA_FORA_DA_PISTA 1
+#define CORRIDA_TEMPO_ESGOTADO 2
+#define CORRIDA_RESOLVEDOR_TERMINOU 3
+
+extern const char *const corrida_nome_falha[];
+
+typedef struct Resultado {
+	int corridas;                            /* corridas completas */
+	double tempo_s[CORRIDA_MAX];             /* da partida a parada na chegada */
+	unsigned int cruzamentos[CORRIDA_MAX];   /* segmentos seguidos ate um cruzamento */
+	unsigned int curvas[CORRIDA_MAX];        /* chamadas a turn() que nao sao 'S' */
+	unsigned int path_length[CORRIDA_MAX];   /* depois de simplify_path() */
+	double fora_da_linha_s[CORRIDA_MAX];     /* seguindo segmento sem fita sob o sensor do meio */
+	int falha;                               /* CORRIDA_* */
+	double falha_s;                          /* tempo virtual da falha */
+} Resultado;
+
+/*
+ * Se nao for 0, corrida_roda() conta ao resolvedor onde fica a chegada,
+ * como compilar main.c com X_SAIDA e Y_SAIDA (opcao -a de main-sim e
+ * main-lote).
+ */
+extern int corrida_conta_saida;
+
+/*
+ * Roda solver_main() no labirinto ate completar 'n_corridas' ou falhar,
+ * preenchendo *res. Nunca volta: chama relata(res), se houver, e termina o
+ * processo com 0 se deu certo ou 2 se falhou. As mudancas de pista do
+ * labirinto sao feitas em *lab depois da primeira corrida.
+ */
+void corrida_roda(Labirinto *lab, unsigned long semente, int n_corridas, double limite_s,
+				  Resultado *res, void (*relata)(const Resultado *res));
+
+#endif
+
+// Local Variables: **
+// mode: C **
+// c-basic-offset: 4 **
+// tab-width: 4 **
+// indent-tabs-mode: t **
+// end: **
@@ -0,0 +1,411 @@
+/*
+ * gera-labirintos.c
+ *
+ * Gera corpus reprodutiveis de labirintos para o simulador. Cada
+ * labirinto depende so do tipo, do tamanho e da sua semente (guardada no
+ * proprio labirinto), entao qualquer um pode ser refeito isoladamente.
+ *
+ * Tipos:
+ *   perfeito    arvore geradora por busca em profundidade (sem lacos)
+ *   lacos       perfeito com fitas extras formando lacos
+ *   corredores  busca em profundidade que prefere seguir reto
+ *   denso       Prim aleatorio: muitos cruzamentos e becos curtos
+ *   mudado      lacos + uma fita do menor caminho tirada depois da
+ *               primeira corrida (o caso de resolve_e_reaprende())
+ *   todos       'quantos' labirintos de cada tipo
+ *
+ * A largada e a chegada ficam sempre em becos (nos com uma saida), com a
+ * chegada no beco mais longe da largada.
+ *
+ * Uso: ./gera-labirintos [-t tipo] [-n quantos] [-s semente] [-l largura]
+ *                        [-a altura] [-c celula_mm] -o saida
+ *
+ * Se 'saida' terminar em .labs eh escrito um corpus binario; senao eh um
+ * diretorio onde vai um arquivo texto por labirinto.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "labirinto.h"
+
+/* Gerador de 32 bits proprio, para o corpus ser igual em qualquer maquina */
+static unsigned long estado;
+
+static void semeia(unsigned long semente)
+{
+	estado = (semente * 2654435761UL + 0x9e3779b9UL) & 0xffffffffUL;
+	if(!estado)
+		estado = 1;
+}
+
+static unsigned int sorteia(unsigned int n)
+{
+	estado ^= (estado << 13) & 0xffffffffUL;
+	estado ^= estado >> 17;
+	estado ^= (estado << 5) & 0xffffffffUL;
+
+	return (unsigned int)(estado % n);
+}
+
+static int dentro(const Labirinto *lab, int x, int y)
+{
+	return x >= 0 && y >= 0 && x < lab->largura && y < lab->altura;
+}
+
+/* Busca em profundidade; 'reto' em % eh a chance de manter a direcao */
+static void profundidade(Labirinto *lab, int reto)
+{
+	static int pilha[LAB_MAX * LAB_MAX];
+	static int ultima[LAB_MAX * LAB_MAX];
+	unsigned char visto[LAB_MAX][LAB_MAX];
+	int topo = 0;
+
+	memset(visto, 0, sizeof(visto));
+
+	pilha[topo] = sorteia(lab->largura) * LAB_MAX + sorteia(lab->altura);
+	ultima[topo++] = -1;
+	visto[pilha[0] / LAB_MAX][pilha[0] % LAB_MAX] = 1;
+
+	while(topo > 0) {
+		int x = pilha[topo - 1] / LAB_MAX;
+		int y = pilha[topo - 1] % LAB_MAX;
+		int opcoes[4];
+		int n = 0, dir;
+
+		for(dir = 0; dir < 4; dir++) {
+			int nx = x + lab_dx[dir], ny = y + lab_dy[dir];
+
+			if(dentro(lab, nx, ny) && !visto[nx][ny])
+				opcoes[n++] = dir;
+		}
+
+		if(n == 0) {
+			topo--;
+			continue;
+		}
+
+		dir = opcoes[sorteia(n)];
+		if(ultima[topo - 1] >= 0 && (int)sorteia(100) < reto) {
+			int i;
+
+			for(i = 0; i < n; i++)
+				if(opcoes[i] == ultima[topo - 1])
+					dir = opcoes[i];
+		}
+
+		lab_liga(lab, x, y, dir, 1);
+		x += lab_dx[dir];
+		y += lab_dy[dir];
+		visto[x][y] = 1;
+		pilha[topo] = x * LAB_MAX + y;
+		ultima[topo++] = dir;
+	}
+}
+
+/* Prim aleatorio: cresce a arvore por uma fronteira sorteada */
+static void prim(Labirinto *lab)
+{
+	static int fronteira[LAB_MAX * LAB_MAX];
+	unsigned char estado_no[LAB_MAX][LAB_MAX]; /* 0 fora, 1 fronteira, 2 dentro */
+	int n = 0;
+	int x = sorteia(lab->largura), y = sorteia(lab->altura);
+	int dir;
+
+	memset(estado_no, 0, sizeof(estado_no));
+
+	while(1) {
+		estado_no[x][y] = 2;
+
+		for(dir = 0; dir < 4; dir++) {
+			int nx = x + lab_dx[dir], ny = y + lab_dy[dir];
+
+			if(dentro(lab, nx, ny) && estado_no[nx][ny] == 0) {
+				estado_no[nx][ny] = 1;
+				fronteira[n++] = nx * LAB_MAX + ny;
+			}
+		}
+
+		if(n == 0)
+			break;
+
+		{
+			int i = sorteia(n);
+			int opcoes[4], m = 0;
+
+			x = fronteira[i] / LAB_MAX;
+			y = fronteira[i] % LAB_MAX;
+			fronteira[i] = fronteira[--n];
+
+			for(dir = 0; dir < 4; dir++) {
+				int nx = x + lab_dx[dir], ny = y + lab_dy[dir];
+
+				if(dentro(lab, nx, ny) && estado_no[nx][ny] == 2)
+					opcoes[m++] = dir;
+			}
+
+			lab_liga(lab, x, y, opcoes[sorteia(m)], 1);
+		}
+	}
+}
+
+/* Escolhe a largada e a chegada entre os becos */
+static int escolhe_pontas(Labirinto *lab)
+{
+	int dist[LAB_MAX][LAB_MAX];
+	int x, y, dir, xl, yl;
+	int melhor = -1;
+
+	/* Largada: o beco mais perto do canto (0,0) */
+	for(x = 0; x < lab->largura; x++) {
+		for(y = 0; y < lab->altura; y++) {
+			if(lab_grau(lab, x, y) == 1 && (melhor < 0 || x + y < melhor)) {
+				melhor = x + y;
+				lab->x_inicio = x;
+				lab->y_inicio = y;
+			}
+		}
+	}
+
+	if(melhor < 0)
+		return 0;
+
+	for(dir = 0; dir < 4; dir++)
+		if(lab->saidas[lab->x_inicio][lab->y_inicio] & LAB_BIT(dir))
+			lab->dir_inicio = dir;
+
+	/* Chegada: o beco mais longe da largada */
+	lab_distancias(lab, lab->x_inicio, lab->y_inicio, dist, &xl, &yl);
+	melhor = -1;
+	for(x = 0; x < lab->largura; x++) {
+		for(y = 0; y < lab->altura; y++) {
+			if(lab_grau(lab, x, y) == 1 && dist[x][y] > melhor) {
+				melhor = dist[x][y];
+				lab->x_fim = x;
+				lab->y_fim = y;
+			}
+		}
+	}
+
+	return melhor > 0;
+}
+
+/* Poe fitas extras sem tocar a largada nem a chegada */
+static void poe_lacos(Labirinto *lab, int quantos)
+{
+	int tentativas = quantos * 20;
+
+	while(quantos > 0 && tentativas-- > 0) {
+		int x = sorteia(lab->largura), y = sorteia(lab->altura);
+		int dir = sorteia(2) ? LAB_NORTE : LAB_LESTE;
+		int nx = x + lab_dx[dir], ny = y + lab_dy[dir];
+
+		if(!dentro(lab, nx, ny) || (lab->saidas[x][y] & LAB_BIT(dir)))
+			continue;
+		if((x == lab->x_inicio && y == lab->y_inicio) || (nx == lab->x_inicio && ny == lab->y_inicio)
+		   || (x == lab->x_fim && y == lab->y_fim) || (nx == lab->x_fim && ny == lab->y_fim))
+			continue;
+
+		lab_liga(lab, x, y, dir, 1);
+		quantos--;
+	}
+}
+
+/*
+ * Tira uma fita do menor caminho da largada ate a chegada, desde que a
+ * chegada continue alcancavel. A fita fica no labirinto e a retirada vai
+ * como mudanca para depois da primeira corrida.
+ */
+static int muda_caminho(Labirinto *lab)
+{
+	int dist[LAB_MAX][LAB_MAX];
+	int caminho_x[LAB_MAX * LAB_MAX], caminho_y[LAB_MAX * LAB_MAX], caminho_dir[LAB_MAX * LAB_MAX];
+	int n = 0, x = lab->x_fim, y = lab->y_fim;
+	int xl, yl, tentativa;
+
+	lab_distancias(lab, lab->x_inicio, lab->y_inicio, dist, &xl, &yl);
+
+	/* Refaz o menor caminho de tras para frente */
+	while(dist[x][y] > 0) {
+		int dir;
+
+		for(dir = 0; dir < 4; dir++) {
+			int px = x + lab_dx[dir], py = y + lab_dy[dir];
+
+			if((lab->saidas[x][y] & LAB_BIT(dir)) && dist[px][py] == dist[x][y] - 1) {
+				caminho_x[n] = px;
+				caminho_y[n] = py;
+				caminho_dir[n++] = (dir + 2) % 4;
+				x = px;
+				y = py;
+				break;
+			}
+		}
+	}
+
+	/* Evita a primeira e a ultima fita, que saem dos becos */
+	for(tentativa = 0; tentativa < n * 2 && n > 2; tentativa++) {
+		int i = 1 + sorteia(n - 2);
+
+		lab_liga(lab, caminho_x[i], caminho_y[i], caminho_dir[i], 0);
+		lab_distancias(lab, lab->x_inicio, lab->y_inicio, dist, &xl, &yl);
+		lab_liga(lab, caminho_x[i], caminho_y[i], caminho_dir[i], 1);
+
+		if(dist[lab->x_fim][lab->y_fim] > 0) {
+			Mudanca *m = &lab->mudancas[lab->n_mudancas++];
+
+			m->x = caminho_x[i];
+			m->y = caminho_y[i];
+			m->dir = caminho_dir[i];
+			m->liga = 0;
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
+static int gera(Labirinto *lab, int tipo, unsigned long semente, int largura, int altura, int celula)
+{
+	int lacos = largura * altura / 8;
+
+	lab_inicializa(lab, largura, altura);
+	lab->celula_mm = celula;
+	lab->tipo = tipo;
+	lab->semente = semente;
+
+	semeia(semente * LAB_N_TIPOS + tipo);
+
+	switch(tipo) {
+	case LAB_PERFEITO:
+	case LAB_LACOS:
+	case LAB_MUDADO:
+		profundidade(lab, 0);
+		break;
+	case LAB_CORREDORES:
+		profundidade(lab, 85);
+		break;
+	case LAB_DENSO:
+		prim(lab);
+		break;
+	default:
+		return 0;
+	}
+
+	if(!escolhe_pontas(lab))
+		return 0;
+
+	if(tipo == LAB_LACOS)
+		poe_lacos(lab, lacos);
+
+	if(tipo == LAB_MUDADO) {
+		poe_lacos(lab, lacos);
+		return muda_caminho(lab);
+	}
+
+	return 1;
+}
+
+static void uso(const char *programa)
+{
+	int i;
+
+	fprintf(stderr, "uso: %s [-t tipo] [-n quantos] [-s semente] [-l largura] [-a altura]"
+			" [-c celula_mm] -o saida(.labs|diretorio)\ntipos: todos", programa);
+	for(i = 1; i < LAB_N_TIPOS; i++)
+		fprintf(stderr, " %s", lab_nome_tipo[i]);
+	fputc('\n', stderr);
+	exit(1);
+}
+
+int main(int argc, char **argv)
+{
+	const char *saida = NULL;
+	const char *nome_tipo = "todos";
+	unsigned long semente = 1;
+	int quantos = 1, largura = 11, altura = 11, celula = 150;
+	int primeiro, ultimo, tipo, i, opcao, gerados = 0;
+	FILE *corpus = NULL;
+
+	while((opcao = getopt(argc, argv, "t:n:s:l:a:c:o:")) != -1) {
+		switch(opcao) {
+		case 't': nome_tipo = optarg; break;
+		case 'n': quantos = atoi(optarg); break;
+		case 's': semente = strtoul(optarg, NULL, 0); break;
+		case 'l': largura = atoi(optarg); break;
+		case 'a': altura = atoi(optarg); break;
+		case 'c': celula = atoi(optarg); break;
+		case 'o': saida = optarg; break;
+		default: uso(argv[0]);
+		}
+	}
+
+	if(!saida || quantos < 1 || largura < 2 || altura < 2 || largura > LAB_MAX || altura > LAB_MAX)
+		uso(argv[0]);
+
+	if(strcmp(nome_tipo, "todos") == 0) {
+		primeiro = 1;
+		ultimo = LAB_N_TIPOS - 1;
+	}
+	else {
+		for(tipo = 1; tipo < LAB_N_TIPOS; tipo++)
+			if(strcmp(nome_tipo, lab_nome_tipo[tipo]) == 0)
+				break;
+		if(tipo == LAB_N_TIPOS)
+			uso(argv[0]);
+		primeiro = ultimo = tipo;
+	}
+
+	if(strlen(saida) > 5 && strcmp(saida + strlen(saida) - 5, ".labs") == 0) {
+		corpus = fopen(saida, "wb");
+		if(!corpus) {
+			perror(saida);
+			return 1;
+		}
+	}
+	else {
+		mkdir(saida, 0777);
+	}
+
+	for(tipo = primeiro; tipo <= ultimo; tipo++) {
+		for(i = 0; i < quantos; i++) {
+			static Labirinto lab;
+			unsigned long s = semente + i;
+
+			/* Sorteios ruins (ex.: sem caminho para mudar) pulam para a proxima semente */
+			while(!gera(&lab, tipo, s, largura, altura, celula))
+				s += quantos;
+
+			if(corpus) {
+				if(lab_escreve_binario(corpus, &lab)) {
+					perror(saida);
+					return 1;
+				}
+			}
+			else {
+				char nome[1024];
+
+				snprintf(nome, sizeof(nome), "%s/%s-%lu.lab", saida, lab_nome_tipo[tipo], s);
+				if(lab_escreve(&lab, nome))
+					return 1;
+			}
+			gerados++;
+		}
+	}
+
+	if(corpus)
+		fclose(corpus);
+
+	fprintf(stderr, "%d labirintos em %s\n", gerados, saida);
+	return 0;
+}
+
+// Local Variables: **
+// mode: C **
+// c-basic-offset: 4 **
+// tab-width: 4 **
+// indent-tabs-mode: t **
+// end: **
@@ -0,0 +1,565 @@
+/*
+ * hal-host.c
+ *
+ * Backend de host da HAL: implementa no Linux as funcoes da libpololu
+ * usadas pelo resolvedor. Motores, sensores e o operador sao delegados a
+ * uma planta (ver hal-host.h); o resto (relogio, LCD, buzzer, calibracao
+ * e read_line) eh emulado aqui seguindo o comportamento da libpololu.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "hal-host.h"
+
+#define N_SENSORES 5
+
+/* Custos em tempo virtual das operacoes que demoram no AVR a 20 MHz */
+#define CUSTO_CARGA_US 10        /* carga dos capacitores do QTR-RC */
+#define CUSTO_CALIBRADO_US 150   /* contas de read_line_sensors_calibrated() */
+#define CUSTO_READ_LINE_US 100   /* media ponderada de read_line() */
+#define CUSTO_LCD_CLEAR_US 1600
+#define CUSTO_LCD_CHAR_US 50
+#define CUSTO_BOTAO_US 10
+#define CUSTO_EEPROM_US 3300     /* apagar e escrever um byte */
+
+static const PlantaHost *planta = NULL;
+
+static unsigned long long agora_us = 0;
+
+static int motor_esq = 0;
+static int motor_dir = 0;
+
+/* Estado dos sensores, igual ao PololuQTRSensors */
+static unsigned int timeout_sensores = 2000;
+static unsigned int calibrado_min[N_SENSORES];
+static unsigned int calibrado_max[N_SENSORES];
+static int calibrado = 0;
+static unsigned int ultima_posicao = 0;
+
+/* O operador virtual aperta e solta estes botoes alternadamente */
+static unsigned char botoes_operador = BUTTON_B;
+static int botao_apertado = 0;
+
+/* LCD 8x2 */
+static char lcd[2][8];
+static int lcd_x = 0;
+static int lcd_y = 0;
+static int lcd_sujo = 0;
+static int lcd_eco = 0;
+
+void host_usa_planta(const PlantaHost *p)
+{
+	planta = p;
+}
+
+/* Interrupcao periodica (host_interrupcao) */
+static void (*interrupcao)(void) = NULL;
+static unsigned long periodo_interrupcao_us = 0;
+static unsigned long long proxima_interrupcao_us = 0;
+static int na_interrupcao = 0;
+
+static int interrupcao_pendente()
+{
+	return interrupcao && !na_interrupcao && agora_us >= proxima_interrupcao_us;
+}
+
+static void atende_interrupcao()
+{
+	na_interrupcao = 1;
+	interrupcao();
+	na_interrupcao = 0;
+
+	/* A propria interrupcao pode ter se desligado */
+	if(!interrupcao)
+		return;
+
+	/* Como o flag do timer: as interrupcoes perdidas viram uma so */
+	proxima_interrupcao_us += periodo_interrupcao_us;
+	if(proxima_interrupcao_us + periodo_interrupcao_us <= agora_us)
+		proxima_interrupcao_us = agora_us - (agora_us - proxima_interrupcao_us) % periodo_interrupcao_us;
+}
+
+void host_avanca_us(unsigned long us)
+{
+	while(us) {
+		unsigned long passo = us;
+
+		/* Anda ate a proxima interrupcao, se ela vier antes */
+		if(interrupcao && !na_interrupcao && proxima_interrupcao_us > agora_us
+		   && proxima_interrupcao_us - agora_us < passo)
+			passo = (unsigned long)(proxima_interrupcao_us - agora_us);
+
+		agora_us += passo;
+		us -= passo;
+
+		if(planta && planta->avanca)
+			planta->avanca(passo);
+
+		if(interrupcao_pendente())
+			atende_interrupcao();
+	}
+}
+
+void host_interrupcao(unsigned long periodo_us, void (*funcao)(void))
+{
+	interrupcao = periodo_us ? funcao : NULL;
+	periodo_interrupcao_us = periodo_us;
+	proxima_interrupcao_us = agora_us + periodo_us;
+}
+
+void sleep_mode()
+{
+	if(interrupcao_pendente())
+		atende_interrupcao();
+	else if(interrupcao && !na_interrupcao)
+		host_avanca_us((unsigned long)(proxima_interrupcao_us - agora_us));
+	else
+		host_avanca_us(1);
+}
+
+unsigned long long host_tempo_us()
+{
+	return agora_us;
+}
+
+void host_motores(int *m1, int *m2)
+{
+	*m1 = motor_esq;
+	*m2 = motor_dir;
+}
+
+/*
+ * Tempo
+ */
+
+void delay_ms(unsigned int milliseconds)
+{
+	host_avanca_us((unsigned long)milliseconds * 1000);
+}
+
+unsigned long get_ms()
+{
+	return (unsigned long)(agora_us / 1000);
+}
+
+/* Ticks de 0.4 us, como no Timer2 da libpololu */
+unsigned long get_ticks()
+{
+	return (unsigned long)(agora_us * 5 / 2);
+}
+
+/*
+ * Motores e sensores
+ */
+
+void pololu_3pi_init(unsigned int line_sensor_timeout)
+{
+	timeout_sensores = line_sensor_timeout;
+	calibrado = 0;
+}
+
+void set_motors(int m1, int m2)
+{
+	if(m1 > 255) m1 = 255;
+	if(m1 < -255) m1 = -255;
+	if(m2 > 255) m2 = 255;
+	if(m2 < -255) m2 = -255;
+
+	motor_esq = m1;
+	motor_dir = m2;
+
+	if(planta && planta->motores)
+		planta->motores(m1, m2);
+}
+
+/* Leitura bruta: como na libpololu, espera o timeout inteiro mesmo que
+ * todos os sensores ja tenham descarregado */
+void read_line_sensors(unsigned int *sensor_values, unsigned char read_mode)
+{
+	int i;
+
+	(void)read_mode;
+
+	for(i = 0; i < N_SENSORES; i++)
+		sensor_values[i] = timeout_sensores;
+
+	if(planta && planta->sensores)
+		planta->sensores(sensor_values, timeout_sensores);
+
+	for(i = 0; i < N_SENSORES; i++) {
+		if(sensor_values[i] > timeout_sensores)
+			sensor_values[i] = timeout_sensores;
+	}
+
+	host_avanca_us(CUSTO_CARGA_US + timeout_sensores * 2 / 5);
+}
+
+void calibrate_line_sensors(unsigned char read_mode)
+{
+	unsigned int sensores[N_SENSORES];
+	unsigned int maximo[N_SENSORES];
+	unsigned int minimo[N_SENSORES];
+	int i, j;
+
+	if(!calibrado) {
+		for(i = 0; i < N_SENSORES; i++) {
+			calibrado_min[i] = timeout_sensores;
+			calibrado_max[i] = 0;
+		}
+		calibrado = 1;
+	}
+
+	for(j = 0; j < 10; j++) {
+		read_line_sensors(sensores, read_mode);
+		for(i = 0; i < N_SENSORES; i++) {
+			if(j == 0 || maximo[i] < sensores[i])
+				maximo[i] = sensores[i];
+			if(j == 0 || minimo[i] > sensores[i])
+				minimo[i] = sensores[i];
+		}
+	}
+
+	/* Como na libpololu: so aceita extremos que se repetiram nas 10 leituras */
+	for(i = 0; i < N_SENSORES; i++) {
+		if(minimo[i] > calibrado_max[i])
+			calibrado_max[i] = minimo[i];
+		if(maximo[i] < calibrado_min[i])
+			calibrado_min[i] = maximo[i];
+	}
+}
+
+void line_sensors_reset_calibration()
+{
+	calibrado = 0;
+}
+
+unsigned int *get_line_sensors_calibrated_minimum_on()
+{
+	return calibrado ? calibrado_min : NULL;
+}
+
+unsigned int *get_line_sensors_calibrated_maximum_on()
+{
+	return calibrado ? calibrado_max : NULL;
+}
+
+void read_line_sensors_calibrated(unsigned int *sensor_values, unsigned char read_mode)
+{
+	int i;
+
+	read_line_sensors(sensor_values, read_mode);
+
+	if(!calibrado)
+		return;
+
+	for(i = 0; i < N_SENSORES; i++) {
+		long denominador = (long)calibrado_max[i] - calibrado_min[i];
+		long x = 0;
+
+		if(denominador != 0)
+			x = ((long)sensor_values[i] - calibrado_min[i]) * 1000 / denominador;
+		if(x < 0)
+			x = 0;
+		else if(x > 1000)
+			x = 1000;
+		sensor_values[i] = x;
+	}
+
+	host_avanca_us(CUSTO_CALIBRADO_US);
+}
+
+/* Mesma media ponderada de PololuQTRSensors::readLine() */
+unsigned int read_line(unsigned int *sensor_values, unsigned char read_mode)
+{
+	long media = 0;
+	long soma = 0;
+	int na_linha = 0;
+	int i;
+
+	read_line_sensors_calibrated(sensor_values, read_mode);
+
+	for(i = 0; i < N_SENSORES; i++) {
+		unsigned int valor = sensor_values[i];
+
+		if(valor > 200)
+			na_linha = 1;
+
+		if(valor > 50) {
+			media += (long)valor * (i * 1000);
+			soma += valor;
+		}
+	}
+
+	host_avanca_us(CUSTO_READ_LINE_US);
+
+	if(!na_linha) {
+		/* Perdeu a linha: devolve o extremo em que ela foi vista por ultimo */
+		if(ultima_posicao < (N_SENSORES - 1) * 1000 / 2)
+			return 0;
+		else
+			return (N_SENSORES - 1) * 1000;
+	}
+
+	ultima_posicao = media / soma;
+
+	return ultima_posicao;
+}
+
+int read_battery_millivolts()
+{
+	return 5000;
+}
+
+/*
+ * Botoes: o operador virtual alterna entre apertar e soltar a cada
+ * consulta, o que satisfaz tanto os lacos "espera apertar" quanto os
+ * "espera soltar" do resolvedor.
+ */
+
+unsigned char button_is_pressed(unsigned char buttons)
+{
+	host_avanca_us(CUSTO_BOTAO_US);
+
+	if(!(buttons & botoes_operador))
+		return 0;
+
+	botao_apertado = !botao_apertado;
+
+	if(botao_apertado && planta && planta->botao)
+		planta->botao(buttons & botoes_operador);
+
+	return botao_apertado ? (buttons & botoes_operador) : 0;
+}
+
+unsigned char wait_for_button_press(unsigned char buttons)
+{
+	while(!button_is_pressed(buttons));
+
+	return buttons & botoes_operador;
+}
+
+unsigned char wait_for_button_release(unsigned char buttons)
+{
+	if(botao_apertado)
+		botao_apertado = 0;
+
+	return buttons & botoes_operador;
+}
+
+unsigned char wait_for_button(unsigned char buttons)
+{
+	unsigned char b = wait_for_button_press(buttons);
+
+	wait_for_button_release(buttons);
+
+	return b;
+}
+
+void host_botoes_operador(unsigned char botoes)
+{
+	botoes_operador = botoes;
+}
+
+/*
+ * EEPROM: a secao "eeprom" do proprio programa. O ld define
+ * __start_eeprom e __stop_eeprom se alguem usar EEMEM.
+ */
+
+extern unsigned char __start_eeprom[] __attribute__((weak));
+extern unsigned char __stop_eeprom[] __attribute__((weak));
+
+static const char *arquivo_eeprom = NULL;
+
+unsigned char eeprom_read_byte(const unsigned char *endereco)
+{
+	return *endereco;
+}
+
+void eeprom_update_byte(unsigned char *endereco, unsigned char valor)
+{
+	if(*endereco == valor)
+		return;
+
+	*endereco = valor;
+	host_avanca_us(CUSTO_EEPROM_US);
+}
+
+void host_eeprom_arquivo(const char *arquivo)
+{
+	FILE *f = fopen(arquivo, "rb");
+	size_t n = __stop_eeprom - __start_eeprom;
+
+	arquivo_eeprom = arquivo;
+
+	// Sem o arquivo a EEPROM fica como saiu do compilador (make eeprom).
+	if(f) {
+		if(fread(__start_eeprom, 1, n, f) != n)
+			fprintf(stderr, "%s: EEPROM incompleta\n", arquivo);
+		fclose(f);
+	}
+}
+
+static void grava_eeprom()
+{
+	FILE *f;
+
+	if(!arquivo_eeprom)
+		return;
+
+	f = fopen(arquivo_eeprom, "wb");
+	if(!f) {
+		perror(arquivo_eeprom);
+		return;
+	}
+	fwrite(__start_eeprom, 1, __stop_eeprom - __start_eeprom, f);
+	fclose(f);
+}
+
+static FILE *serial = NULL;
+
+void host_serial_arquivo(const char *arquivo)
+{
+	serial = fopen(arquivo, "wb");
+	if(!serial)
+		perror(arquivo);
+}
+
+void host_serial_escreve(const unsigned char *dados, unsigned int n)
+{
+	if(serial)
+		fwrite(dados, 1, n, serial);
+}
+
+/*
+ * LCD: guardado num buffer de 8x2; com o eco ligado cada tela eh
+ * impressa na saida de erro antes de ser apagada.
+ */
+
+static void mostra_lcd()
+{
+	int x, y;
+
+	if(!lcd_eco || !lcd_sujo)
+		return;
+
+	fprintf(stderr, "[%10.3f s]", agora_us / 1e6);
+	for(y = 0; y < 2; y++) {
+		fputs(" |", stderr);
+		for(x = 0; x < 8; x++) {
+			unsigned char c = lcd[y][x];
+			fputc(c >= 32 && c < 127 ? c : '#', stderr);
+		}
+		fputc('|', stderr);
+	}
+	fputc('\n', stderr);
+
+	lcd_sujo = 0;
+}
+
+void host_lcd_eco(int ligado)
+{
+	lcd_eco = ligado;
+}
+
+void clear()
+{
+	mostra_lcd();
+
+	memset(lcd, ' ', sizeof(lcd));
+	lcd_x = 0;
+	lcd_y = 0;
+
+	host_avanca_us(CUSTO_LCD_CLEAR_US);
+}
+
+void print_character(char c)
+{
+	if(lcd_x < 8 && lcd_y < 2) {
+		lcd[lcd_y][lcd_x] = c;
+		lcd_sujo = 1;
+	}
+	lcd_x++;
+
+	host_avanca_us(CUSTO_LCD_CHAR_US);
+}
+
+void print(const char *str)
+{
+	while(*str)
+		print_character(*str++);
+}
+
+void print_from_program_space(const char *str)
+{
+	print(str);
+}
+
+void print_long(long value)
+{
+	char texto[12];
+
+	snprintf(texto, sizeof(texto), "%ld", value);
+	print(texto);
+}
+
+void print_unsigned_long(unsigned long value)
+{
+	char texto[12];
+
+	snprintf(texto, sizeof(texto), "%lu", value);
+	print(texto);
+}
+
+void lcd_goto_xy(int col, int row)
+{
+	lcd_x = col;
+	lcd_y = row;
+}
+
+void lcd_load_custom_character(const char *picture, unsigned char number)
+{
+	(void)picture;
+	(void)number;
+}
+
+/*
+ * Buzzer: as musicas sao ignoradas
+ */
+
+void play(const char *sequence)
+{
+	(void)sequence;
+}
+
+void play_from_program_space(const char *sequence)
+{
+	(void)sequence;
+}
+
+unsigned char is_playing()
+{
+	return 0;
+}
+
+void stop_playing()
+{
+}
+
+void host_termina(int codigo)
+{
+	mostra_lcd();
+	grava_eeprom();
+	if(serial)
+		fclose(serial);
+	fflush(stdout);
+	exit(codigo);
+}
+
+// Local Variables: **
+// mode: C **
+// c-basic-offset: 4 **
+// tab-width: 4 **
+// indent-tabs-mode: t **
+// end: **
@@ -0,0 +1,142 @@
+/*
+ * Backend de host da HAL.
+ *
+ * Declara o subconjunto da libpololu usado pelo resolvedor, com os
+ * mesmos nomes e assinaturas de <pololu/3pi.h>, e a interface com a
+ * "planta" (o mundo fisico: motores, sensores e passagem do tempo) que
+ * o programa de host conecta antes de chamar o main() do robo.
+ *
+ * O tempo eh virtual: delay_ms() e as leituras de sensores avancam um
+ * relogio interno em vez de dormir, entao uma corrida inteira roda em
+ * milissegundos de tempo real.
+ */
+
+#ifndef HAL_HOST_H
+#define HAL_HOST_H
+
+/* No host nao existe memoria de programa separada */
+#define PROGMEM
+#define pgm_read_byte(endereco) (*(const unsigned char *)(endereco))
+#define pgm_read_word(endereco) (*(const unsigned int *)(endereco))
+
+/* Modos de leitura dos sensores, iguais aos da libpololu */
+#define IR_EMITTERS_OFF 0
+#define IR_EMITTERS_ON 1
+#define IR_EMITTERS_ON_AND_OFF 2
+
+/* Botoes do 3pi (mesmos pinos da libpololu) */
+#define BUTTON_A (1 << 1)
+#define BUTTON_B (1 << 4)
+#define BUTTON_C (1 << 5)
+#define ANY_BUTTON (BUTTON_A | BUTTON_B | BUTTON_C)
+
+/* Inicializacao, motores e sensores de linha */
+void pololu_3pi_init(unsigned int line_sensor_timeout);
+void set_motors(int m1, int m2);
+void read_line_sensors(unsigned int *sensor_values, unsigned char read_mode);
+void read_line_sensors_calibrated(unsigned int *sensor_values, unsigned char read_mode);
+void calibrate_line_sensors(unsigned char read_mode);
+void line_sensors_reset_calibration();
+unsigned int *get_line_sensors_calibrated_minimum_on();
+unsigned int *get_line_sensors_calibrated_maximum_on();
+unsigned int read_line(unsigned int *sensor_values, unsigned char read_mode);
+int read_battery_millivolts();
+
+/* Tempo */
+void delay_ms(unsigned int milliseconds);
+#define delay(milliseconds) delay_ms(milliseconds)
+unsigned long get_ms();
+unsigned long get_ticks();
+
+/* Botoes */
+unsigned char button_is_pressed(unsigned char buttons);
+unsigned char wait_for_button_press(unsigned char buttons);
+unsigned char wait_for_button_release(unsigned char buttons);
+unsigned char wait_for_button(unsigned char buttons);
+
+/* LCD */
+void clear();
+void print(const char *str);
+void print_from_program_space(const char *str);
+void print_character(char c);
+void print_long(long value);
+void print_unsigned_long(unsigned long value);
+void lcd_goto_xy(int col, int row);
+void lcd_load_custom_character(const char *picture, unsigned char number);
+
+/* Buzzer */
+void play(const char *sequence);
+void play_from_program_space(const char *sequence);
+unsigned char is_playing();
+void stop_playing();
+
+/*
+ * <avr/eeprom.h>: as variaveis EEMEM vao para a secao "eeprom", que
+ * host_eeprom_arquivo() carrega de um arquivo e host_termina() grava de
+ * volta, como se o robo fosse desligado e ligado de novo.
+ */
+#define EEMEM __attribute__((section("eeprom")))
+unsigned char eeprom_read_byte(const unsigned char *endereco);
+void eeprom_update_byte(unsigned char *endereco, unsigned char valor);
+void host_eeprom_arquivo(const char *arquivo);
+
+/* USART0 (telemetria.c): o que o robo transmite vai para o arquivo */
+void host_serial_arquivo(const char *arquivo);
+void host_serial_escreve(const unsigned char *dados, unsigned int n);
+
+/* Botoes que o operador virtual aperta (BUTTON_B se nao mudar) */
+void host_botoes_operador(unsigned char botoes);
+
+/*
+ * Planta: quem usa o backend de host descreve aqui o mundo fisico.
+ * Qualquer ponteiro pode ser nulo.
+ *
+ * motores:  recebe cada comando de set_motors()
+ * sensores: preenche a leitura bruta dos cinco sensores, em ticks de
+ *           0.4 us, como o QTR-RC mediria (ja limitada pelo timeout)
+ * avanca:   integra o mundo por 'us' microssegundos de tempo virtual
+ * botao:    o operador apertou um botao (ex.: recolocar o robo na largada)
+ */
+typedef struct PlantaHost {
+	void (*motores)(int m1, int m2);
+	void (*sensores)(unsigned int *brutos, unsigned int timeout);
+	void (*avanca)(unsigned long us);
+	void (*botao)(unsigned char botoes);
+} PlantaHost;
+
+void host_usa_planta(const PlantaHost *planta);
+
+/* Avanca o relogio virtual e a planta */
+void host_avanca_us(unsigned long us);
+unsigned long long host_tempo_us();
+
+/*
+ * Interrupcao periodica, como a de um timer do AVR: 'funcao' eh chamada a
+ * cada 'periodo_us' de tempo virtual, sem reentrar; se ela demorar mais
+ * que o periodo, a proxima fica pendente e roda logo que ela voltar.
+ * Periodo 0 desliga.
+ */
+void host_interrupcao(unsigned long periodo_us, void (*funcao)(void));
+
+/* <avr/sleep.h>: dormir ate a proxima interrupcao */
+#define SLEEP_MODE_IDLE 0
+#define set_sleep_mode(modo)
+void sleep_mode();
+
+/* Ultimo comando de motores recebido */
+void host_motores(int *m1, int *m2);
+
+/* Liga/desliga o eco do LCD na saida de erro */
+void host_lcd_eco(int ligado);
+
+/* Encerra o programa do robo (o main() dele nunca retorna) */
+void host_termina(int codigo);
+
+#endif
+
+// Local Variables: **
+// mode: C **
+// c-basic-offset: 4 **
+// tab-width: 4 **
+// indent-tabs-mode: t **
+// end: **
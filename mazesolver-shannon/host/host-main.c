@@ -0,0 +1,66 @@
+/*
+ * host-main.c
+ *
+ * Programa de host mais simples: roda o main() do robo (renomeado para
+ * solver_main() pelo Makefile) alimentando os sensores com quadros lidos
+ * da entrada padrao, um quadro por leitura, com os cinco valores brutos
+ * (ticks de 0.4 us) separados por espaco. Termina no fim da entrada.
+ *
+ * Uso: ./main-host [-q] < quadros.txt
+ *   -q  nao mostra o LCD
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "hal-host.h"
+
+int solver_main();
+
+static unsigned long quadros = 0;
+
+static void le_quadro(unsigned int *brutos, unsigned int timeout)
+{
+	int i;
+
+	for(i = 0; i < 5; i++) {
+		if(scanf("%u", &brutos[i]) != 1) {
+			fprintf(stderr, "fim dos quadros: %lu leituras, %lu ms simulados\n",
+					quadros, get_ms());
+			host_termina(0);
+		}
+	}
+
+	(void)timeout;
+	quadros++;
+}
+
+static void mostra_motores(int m1, int m2)
+{
+	printf("%lu %d %d\n", get_ms(), m1, m2);
+}
+
+static const PlantaHost planta_quadros = {
+	mostra_motores,
+	le_quadro,
+	NULL,
+	NULL
+};
+
+int main(int argc, char **argv)
+{
+	host_lcd_eco(!(argc > 1 && strcmp(argv[1], "-q") == 0));
+	host_usa_planta(&planta_quadros);
+
+	solver_main();
+
+	host_termina(0);
+	return 0;
+}
+
+// Local Variables: **
+// mode: C **
+// c-basic-offset: 4 **
+// tab-width: 4 **
+// indent-tabs-mode: t **
+// end: **
@@ -0,0 +1,454 @@
+/*
+ * labirinto.c
+ *
+ * Leitura e escrita dos labirintos do simulador.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "labirinto.h"
+
+const int lab_dx[4] = { 0, 1, 0, -1 };
+const int lab_dy[4] = { 1, 0, -1, 0 };
+
+const char *const lab_nome_tipo[LAB_N_TIPOS] = {
+	"manual", "perfeito", "lacos", "corredores", "denso", "mudado"
+};
+
+static const char nomes_dir[] = "NLSO";
+
+void lab_inicializa(Labirinto *lab, int largura, int altura)
+{
+	memset(lab, 0, sizeof(*lab));
+
+	lab->largura = largura;
+	lab->altura = altura;
+	lab->celula_mm = 150;
+	lab->dir_inicio = LAB_NORTE;
+	lab->x_fim = largura - 1;
+	lab->y_fim = altura - 1;
+}
+
+static int dentro(const Labirinto *lab, int x, int y)
+{
+	return x >= 0 && y >= 0 && x < lab->largura && y < lab->altura;
+}
+
+void lab_liga(Labirinto *lab, int x, int y, int dir, int liga)
+{
+	int nx = x + lab_dx[dir];
+	int ny = y + lab_dy[dir];
+
+	if(!dentro(lab, x, y) || !dentro(lab, nx, ny))
+		return;
+
+	if(liga) {
+		lab->saidas[x][y] |= LAB_BIT(dir);
+		lab->saidas[nx][ny] |= LAB_BIT((dir + 2) % 4);
+	}
+	else {
+		lab->saidas[x][y] &= ~LAB_BIT(dir);
+		lab->saidas[nx][ny] &= ~LAB_BIT((dir + 2) % 4);
+	}
+}
+
+int lab_fita(Labirinto *lab, int x0, int y0, int x1, int y1)
+{
+	int dir;
+
+	if(x0 == x1 && y0 != y1)
+		dir = y1 > y0 ? LAB_NORTE : LAB_SUL;
+	else if(y0 == y1 && x0 != x1)
+		dir = x1 > x0 ? LAB_LESTE : LAB_OESTE;
+	else
+		return 0;
+
+	if(!dentro(lab, x0, y0) || !dentro(lab, x1, y1))
+		return 0;
+
+	while(x0 != x1 || y0 != y1) {
+		lab_liga(lab, x0, y0, dir, 1);
+		x0 += lab_dx[dir];
+		y0 += lab_dy[dir];
+	}
+
+	return 1;
+}
+
+static int direcao(char c)
+{
+	const char *p = strchr(nomes_dir, c);
+
+	return (p && c) ? (int)(p - nomes_dir) : -1;
+}
+
+/* Mudanca entre dois nos vizinhos */
+static int acrescenta_mudanca(Labirinto *lab, int x0, int y0, int x1, int y1, int liga)
+{
+	Mudanca *m;
+	int dir;
+
+	for(dir = 0; dir < 4; dir++)
+		if(x0 + lab_dx[dir] == x1 && y0 + lab_dy[dir] == y1)
+			break;
+
+	if(dir == 4 || !dentro(lab, x0, y0) || !dentro(lab, x1, y1)
+	   || lab->n_mudancas == LAB_MAX_MUDANCAS)
+		return 0;
+
+	m = &lab->mudancas[lab->n_mudancas++];
+	m->x = x0;
+	m->y = y0;
+	m->dir = dir;
+	m->liga = liga;
+
+	return 1;
+}
+
+void lab_aplica_mudancas(Labirinto *lab)
+{
+	int i;
+
+	for(i = 0; i < lab->n_mudancas; i++) {
+		const Mudanca *m = &lab->mudancas[i];
+
+		lab_liga(lab, m->x, m->y, m->dir, m->liga);
+	}
+}
+
+int lab_grau(const Labirinto *lab, int x, int y)
+{
+	int dir, grau = 0;
+
+	for(dir = 0; dir < 4; dir++)
+		if(lab->saidas[x][y] & LAB_BIT(dir))
+			grau++;
+
+	return grau;
+}
+
+void lab_distancias(const Labirinto *lab, int x, int y, int dist[LAB_MAX][LAB_MAX],
+					int *x_longe, int *y_longe)
+{
+	int fila[LAB_MAX * LAB_MAX];
+	int inicio = 0, fim = 0;
+	int i, j;
+
+	for(i = 0; i < LAB_MAX; i++)
+		for(j = 0; j < LAB_MAX; j++)
+			dist[i][j] = -1;
+
+	dist[x][y] = 0;
+	fila[fim++] = x * LAB_MAX + y;
+	*x_longe = x;
+	*y_longe = y;
+
+	while(inicio < fim) {
+		int cx = fila[inicio] / LAB_MAX;
+		int cy = fila[inicio] % LAB_MAX;
+		int dir;
+
+		inicio++;
+
+		if(dist[cx][cy] > dist[*x_longe][*y_longe]) {
+			*x_longe = cx;
+			*y_longe = cy;
+		}
+
+		for(dir = 0; dir < 4; dir++) {
+			int nx = cx + lab_dx[dir];
+			int ny = cy + lab_dy[dir];
+
+			if((lab->saidas[cx][cy] & LAB_BIT(dir)) && dist[nx][ny] < 0) {
+				dist[nx][ny] = dist[cx][cy] + 1;
+				fila[fim++] = nx * LAB_MAX + ny;
+			}
+		}
+	}
+}
+
+/*
+ * Formato binario
+ */
+
+#define LAB_VERSAO 1
+
+int lab_escreve_binario(FILE *f, const Labirinto *lab)
+{
+	unsigned char cabecalho[18];
+	unsigned char grade[LAB_MAX * LAB_MAX * 2 / 8];
+	int n_grade = (lab->largura * lab->altura * 2 + 7) / 8;
+	int i, x, y, bit = 0;
+
+	cabecalho[0] = 'L';
+	cabecalho[1] = 'B';
+	cabecalho[2] = LAB_VERSAO;
+	cabecalho[3] = lab->tipo;
+	for(i = 0; i < 4; i++)
+		cabecalho[4 + i] = (lab->semente >> (8 * i)) & 0xff;
+	cabecalho[8] = lab->largura;
+	cabecalho[9] = lab->altura;
+	cabecalho[10] = lab->celula_mm & 0xff;
+	cabecalho[11] = lab->celula_mm >> 8;
+	cabecalho[12] = lab->x_inicio;
+	cabecalho[13] = lab->y_inicio;
+	cabecalho[14] = lab->dir_inicio;
+	cabecalho[15] = lab->x_fim;
+	cabecalho[16] = lab->y_fim;
+	cabecalho[17] = lab->n_mudancas;
+
+	if(fwrite(cabecalho, sizeof(cabecalho), 1, f) != 1)
+		return -1;
+
+	for(i = 0; i < lab->n_mudancas; i++) {
+		const Mudanca *m = &lab->mudancas[i];
+		unsigned int v = m->x | (m->y << 5) | (m->dir << 10) | (m->liga << 12);
+
+		if(fputc(v & 0xff, f) == EOF || fputc(v >> 8, f) == EOF)
+			return -1;
+	}
+
+	memset(grade, 0, sizeof(grade));
+	for(y = 0; y < lab->altura; y++) {
+		for(x = 0; x < lab->largura; x++) {
+			if(lab->saidas[x][y] & LAB_BIT(LAB_NORTE))
+				grade[bit / 8] |= 1 << (bit % 8);
+			bit++;
+			if(lab->saidas[x][y] & LAB_BIT(LAB_LESTE))
+				grade[bit / 8] |= 1 << (bit % 8);
+			bit++;
+		}
+	}
+
+	if(fwrite(grade, n_grade, 1, f) != 1)
+		return -1;
+
+	return 0;
+}
+
+int lab_le_binario(FILE *f, Labirinto *lab)
+{
+	unsigned char cabecalho[18];
+	unsigned char grade[LAB_MAX * LAB_MAX * 2 / 8];
+	size_t lidos = fread(cabecalho, 1, sizeof(cabecalho), f);
+	int i, x, y, bit = 0;
+
+	if(lidos == 0)
+		return 0;
+
+	if(lidos != sizeof(cabecalho) || cabecalho[0] != 'L' || cabecalho[1] != 'B'
+	   || cabecalho[2] != LAB_VERSAO || cabecalho[8] == 0 || cabecalho[9] == 0
+	   || cabecalho[8] > LAB_MAX || cabecalho[9] > LAB_MAX
+	   || cabecalho[17] > LAB_MAX_MUDANCAS || cabecalho[3] >= LAB_N_TIPOS)
+		return -1;
+
+	lab_inicializa(lab, cabecalho[8], cabecalho[9]);
+	lab->tipo = cabecalho[3];
+	lab->semente = 0;
+	for(i = 0; i < 4; i++)
+		lab->semente |= (unsigned long)cabecalho[4 + i] << (8 * i);
+	lab->celula_mm = cabecalho[10] | (cabecalho[11] << 8);
+	lab->x_inicio = cabecalho[12];
+	lab->y_inicio = cabecalho[13];
+	lab->dir_inicio = cabecalho[14] & 3;
+	lab->x_fim = cabecalho[15];
+	lab->y_fim = cabecalho[16];
+
+	if(!dentro(lab, lab->x_inicio, lab->y_inicio) || !dentro(lab, lab->x_fim, lab->y_fim))
+		return -1;
+
+	for(i = 0; i < cabecalho[17]; i++) {
+		int a = fgetc(f);
+		int b = fgetc(f);
+		unsigned int v;
+		int mx, my, dir;
+
+		if(a == EOF || b == EOF)
+			return -1;
+
+		v = a | (b << 8);
+		mx = v & 31;
+		my = (v >> 5) & 31;
+		dir = (v >> 10) & 3;
+
+		if(!acrescenta_mudanca(lab, mx, my, mx + lab_dx[dir], my + lab_dy[dir], (v >> 12) & 1))
+			return -1;
+	}
+
+	if(fread(grade, (lab->largura * lab->altura * 2 + 7) / 8, 1, f) != 1)
+		return -1;
+
+	for(y = 0; y < lab->altura; y++) {
+		for(x = 0; x < lab->largura; x++) {
+			if(grade[bit / 8] & (1 << (bit % 8)))
+				lab_liga(lab, x, y, LAB_NORTE, 1);
+			bit++;
+			if(grade[bit / 8] & (1 << (bit % 8)))
+				lab_liga(lab, x, y, LAB_LESTE, 1);
+			bit++;
+		}
+	}
+
+	return 1;
+}
+
+int lab_le(Labirinto *lab, const char *arquivo)
+{
+	FILE *f = fopen(arquivo, "r");
+	char linha[256];
+	int n_linha = 0;
+	int tem_tamanho = 0;
+
+	if(!f) {
+		perror(arquivo);
+		return -1;
+	}
+
+	/* Formato binario: le o primeiro registro */
+	if(fgetc(f) == 'L' && fgetc(f) == 'B') {
+		rewind(f);
+		if(lab_le_binario(f, lab) != 1) {
+			fprintf(stderr, "%s: registro binario invalido\n", arquivo);
+			fclose(f);
+			return -1;
+		}
+		fclose(f);
+		return 0;
+	}
+	rewind(f);
+
+	lab_inicializa(lab, 0, 0);
+
+	while(fgets(linha, sizeof(linha), f)) {
+		char comando[32];
+		char dir;
+		int a, b, c, d;
+
+		n_linha++;
+
+		if(sscanf(linha, "%31s", comando) != 1 || comando[0] == '#')
+			continue;
+
+		if(strcmp(comando, "labirinto") == 0 && sscanf(linha, "%*s %d %d", &a, &b) == 2
+		   && a > 0 && b > 0 && a <= LAB_MAX && b <= LAB_MAX) {
+			lab_inicializa(lab, a, b);
+			tem_tamanho = 1;
+		}
+		else if(!tem_tamanho) {
+			break;
+		}
+		else if(strcmp(comando, "celula") == 0 && sscanf(linha, "%*s %d", &a) == 1 && a > 40) {
+			lab->celula_mm = a;
+		}
+		else if(strcmp(comando, "inicio") == 0 && sscanf(linha, "%*s %d %d %c", &a, &b, &dir) == 3
+				&& dentro(lab, a, b) && direcao(dir) >= 0) {
+			lab->x_inicio = a;
+			lab->y_inicio = b;
+			lab->dir_inicio = direcao(dir);
+		}
+		else if(strcmp(comando, "fim") == 0 && sscanf(linha, "%*s %d %d", &a, &b) == 2
+				&& dentro(lab, a, b)) {
+			lab->x_fim = a;
+			lab->y_fim = b;
+		}
+		else if(strcmp(comando, "fita") == 0) {
+			if(sscanf(linha, "%*s %d %d %d %d", &a, &b, &c, &d) != 4 || !lab_fita(lab, a, b, c, d))
+				break;
+		}
+		else if(strcmp(comando, "tira") == 0 || strcmp(comando, "poe") == 0) {
+			if(sscanf(linha, "%*s %d %d %d %d", &a, &b, &c, &d) != 4
+			   || !acrescenta_mudanca(lab, a, b, c, d, comando[0] == 'p'))
+				break;
+		}
+		else if(strcmp(comando, "origem") == 0) {
+			char tipo[32];
+			unsigned long semente;
+
+			if(sscanf(linha, "%*s %31s %lu", tipo, &semente) != 2)
+				break;
+			for(a = 0; a < LAB_N_TIPOS; a++)
+				if(strcmp(tipo, lab_nome_tipo[a]) == 0)
+					lab->tipo = a;
+			lab->semente = semente;
+		}
+		else {
+			break;
+		}
+	}
+
+	if(!feof(f) || !tem_tamanho) {
+		fprintf(stderr, "%s:%d: linha invalida\n", arquivo, n_linha);
+		fclose(f);
+		return -1;
+	}
+
+	fclose(f);
+	return 0;
+}
+
+/* Escreve os trechos de fita de uma direcao, juntando os colineares */
+static void escreve_fitas(const Labirinto *lab, FILE *f, int dir)
+{
+	int x, y;
+
+	for(x = 0; x < lab->largura; x++) {
+		for(y = 0; y < lab->altura; y++) {
+			int x1 = x, y1 = y;
+
+			if(!(lab->saidas[x][y] & LAB_BIT(dir)))
+				continue;
+
+			/* So comeca trecho onde o anterior nao continua */
+			if(lab->saidas[x][y] & LAB_BIT((dir + 2) % 4))
+				continue;
+
+			while(lab->saidas[x1][y1] & LAB_BIT(dir)) {
+				x1 += lab_dx[dir];
+				y1 += lab_dy[dir];
+			}
+
+			fprintf(f, "fita %d %d %d %d\n", x, y, x1, y1);
+		}
+	}
+}
+
+int lab_escreve(const Labirinto *lab, const char *arquivo)
+{
+	FILE *f = strcmp(arquivo, "-") == 0 ? stdout : fopen(arquivo, "w");
+	int i;
+
+	if(!f) {
+		perror(arquivo);
+		return -1;
+	}
+
+	fprintf(f, "labirinto %d %d\n", lab->largura, lab->altura);
+	if(lab->tipo != LAB_MANUAL)
+		fprintf(f, "origem %s %lu\n", lab_nome_tipo[lab->tipo], lab->semente);
+	fprintf(f, "celula %d\n", lab->celula_mm);
+	fprintf(f, "inicio %d %d %c\n", lab->x_inicio, lab->y_inicio, nomes_dir[lab->dir_inicio]);
+	fprintf(f, "fim %d %d\n", lab->x_fim, lab->y_fim);
+
+	escreve_fitas(lab, f, LAB_LESTE);
+	escreve_fitas(lab, f, LAB_NORTE);
+
+	for(i = 0; i < lab->n_mudancas; i++) {
+		const Mudanca *m = &lab->mudancas[i];
+
+		fprintf(f, "%s %d %d %d %d\n", m->liga ? "poe" : "tira",
+				m->x, m->y, m->x + lab_dx[m->dir], m->y + lab_dy[m->dir]);
+	}
+
+	if(f != stdout)
+		fclose(f);
+
+	return 0;
+}
+
+// Local Variables: **
+// mode: C **
+// c-basic-offset: 4 **
+// tab-width: 4 **
+// indent-tabs-mode: t **
+// end: **
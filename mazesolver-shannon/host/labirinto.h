@@ -0,0 +1,135 @@
+/*
+ * Labirinto de fita usado pelo simulador.
+ *
+ * O labirinto eh uma grade de nos espacados de 'celula_mm'; cada no guarda
+ * as saidas (pedacos de fita) para norte, leste, sul e oeste. As direcoes
+ * seguem a numeracao de maze.c: NORTE = y+1, LESTE = x+1.
+ */
+
+#ifndef LABIRINTO_H
+#define LABIRINTO_H
+
+#include <stdio.h>
+
+#define LAB_MAX 32
+
+#define LAB_NORTE 0
+#define LAB_LESTE 1
+#define LAB_SUL 2
+#define LAB_OESTE 3
+
+#define LAB_BIT(dir) (1 << (dir))
+
+/* Como o labirinto foi feito (ver gera-labirintos.c) */
+#define LAB_MANUAL 0
+#define LAB_PERFEITO 1
+#define LAB_LACOS 2
+#define LAB_CORREDORES 3
+#define LAB_DENSO 4
+#define LAB_MUDADO 5
+#define LAB_N_TIPOS 6
+
+extern const char *const lab_nome_tipo[LAB_N_TIPOS];
+
+/*
+ * Mudanca feita na pista depois da primeira corrida, como as que
+ * resolve_e_reaprende() precisa descobrir: tira ou poe a fita que sai do
+ * no (x,y) na direcao 'dir'.
+ */
+#define LAB_MAX_MUDANCAS 8
+
+typedef struct Mudanca {
+	unsigned char x;
+	unsigned char y;
+	unsigned char dir;
+	unsigned char liga;
+} Mudanca;
+
+typedef struct Labirinto {
+	int largura;
+	int altura;
+	int celula_mm;
+	unsigned char saidas[LAB_MAX][LAB_MAX];
+	int x_inicio;
+	int y_inicio;
+	int dir_inicio;
+	int x_fim;
+	int y_fim;
+	int n_mudancas;
+	Mudanca mudancas[LAB_MAX_MUDANCAS];
+	int tipo;
+	unsigned long semente;
+} Labirinto;
+
+/* Deslocamento de cada direcao na grade */
+extern const int lab_dx[4];
+extern const int lab_dy[4];
+
+void lab_inicializa(Labirinto *lab, int largura, int altura);
+
+/* Poe fita entre dois nos vizinhos (ou tira, se 'liga' for 0) */
+void lab_liga(Labirinto *lab, int x, int y, int dir, int liga);
+
+/* Poe fita reta de (x0,y0) ate (x1,y1); devolve 0 se nao for reta */
+int lab_fita(Labirinto *lab, int x0, int y0, int x1, int y1);
+
+/*
+ * Le o labirinto do arquivo no formato texto:
+ *
+ *   # comentario
+ *   labirinto 11 11      largura e altura em nos
+ *   celula 150           espacamento dos nos em mm (opcional)
+ *   inicio 0 0 N         no e orientacao de largada (N, L, S ou O)
+ *   fim 10 10            no com o quadrado de chegada
+ *   fita 0 0 0 5         trecho reto de fita entre dois nos
+ *   tira 4 4 4 5         depois da primeira corrida, tira esta fita
+ *   poe 4 4 5 4          depois da primeira corrida, poe esta fita
+ *   origem lacos 1234    tipo e semente de quem gerou (opcional)
+ *
+ * O arquivo tambem pode estar no formato binario (ver lab_le_binario);
+ * nesse caso eh lido o primeiro registro. Devolve 0 se deu certo e
+ * imprime o erro em stderr caso contrario.
+ */
+int lab_le(Labirinto *lab, const char *arquivo);
+
+/* Escreve no mesmo formato texto, juntando trechos colineares */
+int lab_escreve(const Labirinto *lab, const char *arquivo);
+
+/*
+ * Formato binario: registros de tamanho variavel que podem ser
+ * concatenados num arquivo de corpus (.labs). Cada registro tem
+ *
+ *   'L' 'B' versao tipo semente(4) largura altura celula(2)
+ *   x_inicio y_inicio dir_inicio x_fim y_fim n_mudancas
+ *   n_mudancas * 2 bytes: x(5 bits) y(5) dir(2) liga(1)
+ *   largura * altura * 2 bits: fita para norte e para leste de cada no
+ *
+ * com inteiros em little endian; um 11x11 ocupa 49 bytes.
+ *
+ * lab_le_binario() devolve 1 se leu um registro, 0 no fim do arquivo e
+ * -1 se o registro for invalido.
+ */
+int lab_le_binario(FILE *f, Labirinto *lab);
+int lab_escreve_binario(FILE *f, const Labirinto *lab);
+
+/* Aplica as mudancas de pista (antes da segunda corrida) */
+void lab_aplica_mudancas(Labirinto *lab);
+
+/* Numero de saidas do no */
+int lab_grau(const Labirinto *lab, int x, int y);
+
+/*
+ * Distancia em nos de (x,y) ate cada no, pela fita; -1 se nao alcanca.
+ * Devolve o no alcancavel mais distante em *x_longe, *y_longe.
+ */
+void lab_distancias(const Labirinto *lab, int x, int y, int dist[LAB_MAX][LAB_MAX],
+					int *x_longe, int *y_longe);
+
+#endif
+
+// Local Variables: **
+// mode: C **
+// c-basic-offset: 4 **
+// tab-width: 4 **
+// indent-tabs-mode: t **
+// end: **
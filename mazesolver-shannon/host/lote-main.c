@@ -0,0 +1,420 @@
+/*
+ * lote-main.c
+ *
+ * Roda aprendizado e repeticao do resolvedor sobre um corpus inteiro de
+ * labirintos, usando todos os nucleos, e escreve um CSV com uma linha por
+ * labirinto mais uma tabela de resumo por tipo de labirinto.
+ *
+ * O resolvedor guarda tudo em variaveis globais e nunca volta de main(),
+ * entao cada labirinto roda num processo filho proprio (fork); o
+ * resultado volta por memoria compartilhada. Cada vaga livre pega o
+ * proximo labirinto da fila assim que o anterior termina, de modo que
+ * labirintos lentos nao seguram os outros. Um filho que morre (sinal),
+ * passa do limite de tempo real ou sai com erro antes de correr vira uma
+ * falha no relatorio.
+ *
+ * Uso: ./main-lote [-j processos] [-a] [-s semente] [-t limite_s] [-o saida.csv]
+ *                  corpus.labs|labirinto.txt...
+ *
+ * Com -a o robo sabe de antemao onde fica a chegada (ver X_SAIDA em
+ * main.c). Sem -o o CSV vai para a saida padrao; o resumo vai sempre para stderr.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+
+#include "corrida.h"
+
+#define N_CORRIDAS 2        /* aprendizado e repeticao */
+#define LIMITE_REAL_S 10    /* tempo de parede maximo de um labirinto */
+
+/* Estado de um labirinto no relatorio, alem de CORRIDA_* */
+#define ESTADO_SINAL 10
+#define ESTADO_NAO_RODOU 11
+#define ESTADO_SAIDA 12     /* saiu com erro sem o resultado dizer por que */
+
+typedef struct Item {
+	Labirinto lab;
+	char nome[64];
+	int estado;
+	int sinal;
+	int saida;
+} Item;
+
+static Item *itens = NULL;
+static int n_itens = 0;
+static int cabem = 0;
+
+static Item *novo_item(const char *arquivo, int registro)
+{
+	Item *item;
+	const char *base = strrchr(arquivo, '/');
+
+	if(n_itens == cabem) {
+		cabem = cabem ? 2 * cabem : 256;
+		itens = realloc(itens, cabem * sizeof(Item));
+		if(!itens) {
+			perror("realloc");
+			exit(1);
+		}
+	}
+
+	item = &itens[n_itens];
+	memset(item, 0, sizeof(*item));
+	base = base ? base + 1 : arquivo;
+
+	if(registro < 0)
+		snprintf(item->nome, sizeof(item->nome), "%s", base);
+	else
+		snprintf(item->nome, sizeof(item->nome), "%s:%d", base, registro);
+
+	item->estado = ESTADO_NAO_RODOU;
+	return item;
+}
+
+/* Le um labirinto texto ou todos os registros de um corpus binario */
+static int carrega(const char *arquivo)
+{
+	FILE *f = fopen(arquivo, "rb");
+	int binario, registro, lidos;
+
+	if(!f) {
+		perror(arquivo);
+		return -1;
+	}
+
+	binario = fgetc(f) == 'L' && fgetc(f) == 'B';
+	rewind(f);
+
+	if(!binario) {
+		fclose(f);
+		if(lab_le(&novo_item(arquivo, -1)->lab, arquivo))
+			return -1;
+		n_itens++;
+		return 0;
+	}
+
+	for(registro = 0; (lidos = lab_le_binario(f, &novo_item(arquivo, registro)->lab)) == 1; registro++)
+		n_itens++;
+
+	fclose(f);
+
+	if(lidos < 0) {
+		fprintf(stderr, "%s: registro %d invalido\n", arquivo, registro);
+		return -1;
+	}
+
+	return 0;
+}
+
+/* Processo filho: roda um labirinto e termina */
+static void roda(int i, Resultado *res, unsigned long semente, double limite_s)
+{
+	signal(SIGALRM, SIG_DFL);
+	alarm(LIMITE_REAL_S);
+
+	/* Com milhares de filhos, o eco do LCD so atrapalharia o resumo */
+	if(!freopen("/dev/null", "w", stderr))
+		_exit(2);
+
+	corrida_roda(&itens[i].lab, semente + i, N_CORRIDAS, limite_s, res, NULL);
+	_exit(2);
+}
+
+static const char *nome_estado(const Item *item)
+{
+	static char nome[16];
+
+	if(item->estado == ESTADO_SINAL) {
+		snprintf(nome, sizeof(nome), "sinal %d", item->sinal);
+		return nome;
+	}
+
+	if(item->estado == ESTADO_NAO_RODOU)
+		return "nao rodou";
+
+	if(item->estado == ESTADO_SAIDA) {
+		snprintf(nome, sizeof(nome), "saida %d", item->saida);
+		return nome;
+	}
+
+	return corrida_nome_falha[item->estado];
+}
+
+static void escreve_csv(FILE *f, const Resultado *res)
+{
+	int i, k;
+
+	fprintf(f, "labirinto,tipo,semente,largura,altura,estado,"
+			"aprendizado_s,repeticao_s,"
+			"cruzamentos_aprendizado,cruzamentos_repeticao,"
+			"curvas_aprendizado,curvas_repeticao,"
+			"path_length_aprendizado,path_length_repeticao\n");
+
+	for(i = 0; i < n_itens; i++) {
+		const Item *item = &itens[i];
+		const Resultado *r = &res[i];
+
+		fprintf(f, "%s,%s,%lu,%d,%d,%s", item->nome, lab_nome_tipo[item->lab.tipo],
+				item->lab.semente, item->lab.largura, item->lab.altura, nome_estado(item));
+
+		for(k = 0; k < N_CORRIDAS; k++) {
+			if(k < r->corridas)
+				fprintf(f, ",%.3f", r->tempo_s[k]);
+			else
+				fprintf(f, ",");
+		}
+
+		for(k = 0; k < N_CORRIDAS; k++) {
+			if(k < r->corridas)
+				fprintf(f, ",%u", r->cruzamentos[k]);
+			else
+				fprintf(f, ",");
+		}
+
+		for(k = 0; k < N_CORRIDAS; k++) {
+			if(k < r->corridas)
+				fprintf(f, ",%u", r->curvas[k]);
+			else
+				fprintf(f, ",");
+		}
+
+		for(k = 0; k < N_CORRIDAS; k++) {
+			if(k < r->corridas)
+				fprintf(f, ",%u", r->path_length[k]);
+			else
+				fprintf(f, ",");
+		}
+
+		fprintf(f, "\n");
+	}
+}
+
+/* Somas de uma linha do resumo; medias so dos labirintos resolvidos */
+typedef struct Soma {
+	int labirintos;
+	int ok;
+	int falhas[ESTADO_SAIDA + 1];
+	double aprendizado_s;
+	double repeticao_s;
+	double cruzamentos;
+	double curvas;
+	double path_length;
+} Soma;
+
+static void soma(Soma *s, const Item *item, const Resultado *r)
+{
+	s->labirintos++;
+
+	if(item->estado != CORRIDA_OK) {
+		s->falhas[item->estado]++;
+		return;
+	}
+
+	s->ok++;
+	s->aprendizado_s += r->tempo_s[0];
+	s->repeticao_s += r->tempo_s[1];
+	s->cruzamentos += r->cruzamentos[0];
+	s->curvas += r->curvas[0];
+	s->path_length += r->path_length[0];
+}
+
+static void linha_resumo(const char *nome, const Soma *s)
+{
+	int n = s->ok ? s->ok : 1;
+
+	fprintf(stderr, "%-12s %6d %6d %6d %6d %6d %9.2f %9.2f %7.1f %7.1f %7.1f\n", nome,
+			s->labirintos, s->ok,
+			s->falhas[CORRIDA_FORA_DA_PISTA],
+			s->falhas[CORRIDA_TEMPO_ESGOTADO],
+			s->falhas[CORRIDA_RESOLVEDOR_TERMINOU] + s->falhas[ESTADO_SINAL] +
+			s->falhas[ESTADO_NAO_RODOU] + s->falhas[ESTADO_SAIDA],
+			s->aprendizado_s / n, s->repeticao_s / n,
+			s->cruzamentos / n, s->curvas / n, s->path_length / n);
+}
+
+static void escreve_resumo(const Resultado *res, int processos, double parede_s)
+{
+	Soma por_tipo[LAB_N_TIPOS];
+	Soma total;
+	int i;
+
+	memset(por_tipo, 0, sizeof(por_tipo));
+	memset(&total, 0, sizeof(total));
+
+	for(i = 0; i < n_itens; i++) {
+		soma(&por_tipo[itens[i].lab.tipo], &itens[i], &res[i]);
+		soma(&total, &itens[i], &res[i]);
+	}
+
+	fprintf(stderr, "\n%-12s %6s %6s %6s %6s %6s %9s %9s %7s %7s %7s\n", "tipo",
+			"labs", "ok", "fora", "tempo", "erro", "apr(s)", "rep(s)", "cruz", "curvas", "path");
+
+	for(i = 0; i < LAB_N_TIPOS; i++)
+		if(por_tipo[i].labirintos)
+			linha_resumo(lab_nome_tipo[i], &por_tipo[i]);
+
+	linha_resumo("total", &total);
+
+	fprintf(stderr, "\n%d labirintos em %.1f s com %d processos (%.1f labirintos/s)\n",
+			n_itens, parede_s, processos, n_itens / (parede_s > 0 ? parede_s : 1));
+}
+
+static double agora_s()
+{
+	struct timeval tv;
+
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+int main(int argc, char **argv)
+{
+	unsigned long semente = 1;
+	double limite_s = 600;
+	int processos = (int)sysconf(_SC_NPROCESSORS_ONLN);
+	const char *saida = NULL;
+	Resultado *res;
+	pid_t *pids;
+	int *rodando_em;
+	int opcao, i, proximo, rodando, status;
+	double inicio_s;
+	FILE *f;
+
+	while((opcao = getopt(argc, argv, "j:as:t:o:")) != -1) {
+		switch(opcao) {
+		case 'j':
+			processos = atoi(optarg);
+			break;
+		case 'a':
+			corrida_conta_saida = 1;
+			break;
+		case 's':
+			semente = strtoul(optarg, NULL, 0);
+			break;
+		case 't':
+			limite_s = atof(optarg);
+			break;
+		case 'o':
+			saida = optarg;
+			break;
+		default:
+			optind = argc;
+			break;
+		}
+	}
+
+	if(optind == argc || processos < 1) {
+		fprintf(stderr, "uso: %s [-j processos] [-a] [-s semente] [-t limite_s] [-o saida.csv] "
+				"corpus.labs|labirinto.txt...\n", argv[0]);
+		return 1;
+	}
+
+	for(i = optind; i < argc; i++)
+		if(carrega(argv[i]))
+			return 1;
+
+	if(!n_itens) {
+		fprintf(stderr, "nenhum labirinto\n");
+		return 1;
+	}
+
+	res = mmap(NULL, n_itens * sizeof(Resultado), PROT_READ | PROT_WRITE,
+			   MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	pids = calloc(processos, sizeof(pid_t));
+	rodando_em = calloc(processos, sizeof(int));
+	if(res == MAP_FAILED || !pids || !rodando_em) {
+		perror("mmap");
+		return 1;
+	}
+	memset(res, 0, n_itens * sizeof(Resultado));
+
+	inicio_s = agora_s();
+	proximo = 0;
+	rodando = 0;
+
+	while(proximo < n_itens || rodando) {
+		pid_t pid;
+		int vaga;
+
+		/* Enche as vagas livres com os proximos labirintos da fila */
+		for(vaga = 0; vaga < processos && proximo < n_itens; vaga++) {
+			if(pids[vaga])
+				continue;
+
+			fflush(NULL);
+			pid = fork();
+			if(pid < 0) {
+				perror("fork");
+				return 1;
+			}
+			if(pid == 0)
+				roda(proximo, &res[proximo], semente, limite_s);
+
+			pids[vaga] = pid;
+			rodando_em[vaga] = proximo;
+			proximo++;
+			rodando++;
+		}
+
+		pid = wait(&status);
+		if(pid < 0) {
+			perror("wait");
+			return 1;
+		}
+
+		for(vaga = 0; vaga < processos && pids[vaga] != pid; vaga++)
+			;
+		if(vaga == processos)
+			continue;
+
+		pids[vaga] = 0;
+		rodando--;
+		i = rodando_em[vaga];
+
+		if(WIFSIGNALED(status)) {
+			itens[i].estado = ESTADO_SINAL;
+			itens[i].sinal = WTERMSIG(status);
+		}
+		else if(res[i].falha == CORRIDA_OK && WEXITSTATUS(status)) {
+			/* Morreu antes de corrida_roda() escrever o resultado */
+			itens[i].estado = ESTADO_SAIDA;
+			itens[i].saida = WEXITSTATUS(status);
+		}
+		else {
+			itens[i].estado = res[i].falha;
+		}
+	}
+
+	if(saida) {
+		f = fopen(saida, "w");
+		if(!f) {
+			perror(saida);
+			return 1;
+		}
+	}
+	else {
+		f = stdout;
+	}
+
+	escreve_csv(f, res);
+	if(f != stdout)
+		fclose(f);
+
+	escreve_resumo(res, processos, agora_s() - inicio_s);
+
+	return 0;
+}
+
+// Local Variables: **
+// mode: C **
+// c-basic-offset: 4 **
+// tab-width: 4 **
+// indent-tabs-mode: t **
+// end: **
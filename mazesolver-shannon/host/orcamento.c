@@ -0,0 +1,462 @@
+/*
+ * orcamento.c
+ *
+ * Orcamento de memoria do firmware (make orcamento): quanto cada objeto
+ * ocupa de flash e de SRAM e qual a pilha no pior caso, falhando se o
+ * atmega328p nao tiver espaco. Os 2 KB de SRAM guardam .data, .bss, o que
+ * a libpololu aloca com malloc() e a pilha, que cresce de cima para baixo
+ * ate encontrar o resto; quando encontra, o robo trava na pista sem
+ * aviso nenhum.
+ *
+ * Entradas, todas geradas pelo Makefile:
+ *   tamanhos   saida de avr-size (formato berkeley) dos objetos e, na
+ *              ultima linha, do firmware ligado, com a libpololu
+ *   desmontado saida de avr-objdump -dr dos objetos: as instrucoes de
+ *              chamada e as relocacoes dao o grafo de chamadas
+ *   .su        um por objeto, do -fstack-usage: o quadro de cada funcao
+ *
+ * A pilha de uma funcao eh o seu quadro mais a maior entre as das funcoes
+ * que ela chama, somando o endereco de retorno (-c bytes) em cada call;
+ * um jmp para outra funcao (chamada de cauda) nao soma nada. Funcoes de
+ * fora dos objetos (libpololu, avr-libc) e chamadas por ponteiro custam
+ * -e bytes cada, uma estimativa; as auxiliares da libgcc (nome comecando
+ * com __) so o endereco de retorno. O pior caso eh a pior raiz (funcao
+ * que ninguem chama, como main) mais a pior interrupcao (__vector_*), ou
+ * -e bytes se nenhuma estiver nos objetos, pelas da libpololu.
+ *
+ * Uso: ./host/orcamento [-f flash] [-r ram] [-m malloc] [-e externa]
+ *                       [-c chamada] tamanhos desmontado objeto.su...
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define MAX_FUNCOES 1024
+#define MAX_CHAMADAS 8192
+#define MAX_NOME 128
+
+typedef struct Funcao {
+	char objeto[MAX_NOME];
+	char nome[MAX_NOME];
+	unsigned long endereco;
+	int quadro;                 /* -1: sem .su */
+	char indireta;              /* chama por ponteiro */
+	char chamada;               /* alguem chama */
+	int pilha;                  /* -1: ainda nao calculada */
+	int proxima;                /* quem da o pior caso, -1 se ninguem */
+	char visitando;
+} Funcao;
+
+typedef struct Chamada {
+	int de;
+	char objeto[MAX_NOME];
+	char alvo[MAX_NOME];        /* nome, ou secao+deslocamento */
+	char cauda;                 /* jmp: sem endereco de retorno */
+} Chamada;
+
+static Funcao funcoes[MAX_FUNCOES];
+static int n_funcoes;
+static Chamada chamadas[MAX_CHAMADAS];
+static int n_chamadas;
+
+static int custo_externa = 32;
+static int custo_chamada = 2;
+static int recursiva;
+
+/* "dir/main.o" -> "main" */
+static void nome_do_objeto(char *objeto, const char *caminho, const char *sufixo)
+{
+	const char *barra = strrchr(caminho, '/');
+	size_t n;
+
+	snprintf(objeto, MAX_NOME, "%s", barra ? barra + 1 : caminho);
+	n = strlen(objeto);
+	if(n > strlen(sufixo) && strcmp(objeto + n - strlen(sufixo), sufixo) == 0)
+		objeto[n - strlen(sufixo)] = 0;
+}
+
+static int procura(const char *objeto, const char *nome)
+{
+	int i, global = -1;
+
+	for(i = 0; i < n_funcoes; i++) {
+		if(strcmp(funcoes[i].nome, nome) != 0)
+			continue;
+		if(strcmp(funcoes[i].objeto, objeto) == 0)
+			return i;
+		global = i;
+	}
+
+	return global;
+}
+
+/* Alvo "secao+0x2a": a funcao do objeto que comeca nesse endereco */
+static int procura_endereco(const char *objeto, unsigned long endereco)
+{
+	int i;
+
+	for(i = 0; i < n_funcoes; i++)
+		if(funcoes[i].endereco == endereco && strcmp(funcoes[i].objeto, objeto) == 0)
+			return i;
+
+	return -1;
+}
+
+static int nova_funcao(const char *objeto, const char *nome, unsigned long endereco)
+{
+	Funcao *f;
+
+	if(n_funcoes == MAX_FUNCOES) {
+		fprintf(stderr, "orcamento: mais de %d funcoes\n", MAX_FUNCOES);
+		exit(2);
+	}
+
+	f = &funcoes[n_funcoes];
+	snprintf(f->objeto, MAX_NOME, "%s", objeto);
+	snprintf(f->nome, MAX_NOME, "%s", nome);
+	f->endereco = endereco;
+	f->quadro = -1;
+	f->pilha = -1;
+	f->proxima = -1;
+
+	return n_funcoes++;
+}
+
+static void nova_chamada(int de, const char *objeto, const char *alvo, char cauda)
+{
+	Chamada *c;
+
+	if(de < 0)
+		return;
+	if(n_chamadas == MAX_CHAMADAS) {
+		fprintf(stderr, "orcamento: mais de %d chamadas\n", MAX_CHAMADAS);
+		exit(2);
+	}
+
+	c = &chamadas[n_chamadas++];
+	c->de = de;
+	snprintf(c->objeto, MAX_NOME, "%s", objeto);
+	snprintf(c->alvo, MAX_NOME, "%s", alvo);
+	c->cauda = cauda;
+}
+
+/*
+ * Linhas que interessam do avr-objdump -dr:
+ *   main.o:     file format elf32-avr
+ *   00000000 <vira>:
+ *     1c:	0e 94 00 00 	call	0	; 0x0 <vira>
+ *   			1e: R_AVR_CALL	turn
+ * O alvo vem da relocacao; sem ela (alvo ja resolvido pelo montador),
+ * do <nome> da propria instrucao.
+ */
+static void le_desmontado(FILE *f)
+{
+	char linha[1024], objeto[MAX_NOME] = "", sugerido[MAX_NOME] = "";
+	int atual = -1;
+	char pendente = 0;   /* 0, 'c' (call) ou 'j' (jmp) */
+
+	while(fgets(linha, sizeof(linha), f)) {
+		char nome[MAX_NOME], *p;
+		unsigned long endereco;
+
+		if(strstr(linha, ": R_")) {
+			if(pendente) {
+				p = strchr(strstr(linha, ": R_") + 2, '\t');
+				if(!p)
+					p = strchr(strstr(linha, ": R_") + 2, ' ');
+				if(p && sscanf(p, " %127s", nome) == 1)
+					nova_chamada(atual, objeto, nome, pendente == 'j');
+				pendente = 0;
+			}
+			continue;
+		}
+
+		/* Chamada sem relocacao */
+		if(pendente && sugerido[0])
+			nova_chamada(atual, objeto, sugerido, pendente == 'j');
+		pendente = 0;
+
+		if((p = strstr(linha, ":     file format"))) {
+			*p = 0;
+			nome_do_objeto(objeto, linha, ".o");
+			atual = -1;
+		}
+		else if(sscanf(linha, "%lx <%127[^>]>:", &endereco, nome) == 2) {
+			atual = procura_endereco(objeto, endereco);
+			if(atual < 0 || strcmp(funcoes[atual].nome, nome) != 0)
+				atual = nova_funcao(objeto, nome, endereco);
+		}
+		else if(atual >= 0 && (p = strchr(linha, ':')) && (p = strchr(p, '\t'))
+				&& (p = strchr(p + 1, '\t'))) {
+			char instrucao[32];
+			char *alvo;
+
+			if(sscanf(p + 1, "%31s", instrucao) != 1)
+				continue;
+
+			if(strcmp(instrucao, "icall") == 0 || strcmp(instrucao, "eicall") == 0
+			   || strcmp(instrucao, "ijmp") == 0 || strcmp(instrucao, "eijmp") == 0
+			   || ((strncmp(instrucao, "call", 4) == 0 || strncmp(instrucao, "jmp", 3) == 0)
+				   && strchr(p, '*'))) {
+				funcoes[atual].indireta = 1;
+				continue;
+			}
+
+			if(strncmp(instrucao, "call", 4) == 0 || strcmp(instrucao, "rcall") == 0)
+				pendente = 'c';
+			else if(strncmp(instrucao, "jmp", 3) == 0 || strcmp(instrucao, "rjmp") == 0)
+				pendente = 'j';
+			else
+				continue;
+
+			/* "<turn>" vale; "<vira+0x1c>" eh um salto dentro da funcao */
+			sugerido[0] = 0;
+			if((alvo = strrchr(p, '<')) && sscanf(alvo, "<%127[^>]>", nome) == 1
+			   && !strchr(nome, '+'))
+				strcpy(sugerido, nome);
+		}
+	}
+
+	if(pendente && sugerido[0])
+		nova_chamada(atual, objeto, sugerido, pendente == 'j');
+}
+
+/* Linhas "main.c:123:6:vira\t12\tstatic" */
+static void le_su(const char *arquivo)
+{
+	char linha[1024], objeto[MAX_NOME], nome[MAX_NOME];
+	FILE *f = fopen(arquivo, "r");
+	int quadro, i;
+
+	if(!f) {
+		perror(arquivo);
+		exit(2);
+	}
+	nome_do_objeto(objeto, arquivo, ".su");
+
+	while(fgets(linha, sizeof(linha), f)) {
+		char *tab = strchr(linha, '\t'), *p;
+
+		if(!tab)
+			continue;
+		*tab = 0;
+		p = strrchr(linha, ':');
+		if(!p || sscanf(tab + 1, "%d", &quadro) != 1)
+			continue;
+		snprintf(nome, sizeof(nome), "%s", p + 1);
+
+		for(i = 0; i < n_funcoes; i++)
+			if(strcmp(funcoes[i].objeto, objeto) == 0 && strcmp(funcoes[i].nome, nome) == 0)
+				funcoes[i].quadro = quadro;
+	}
+
+	fclose(f);
+}
+
+/* Quem eh o alvo da chamada; -1 se for de fora dos objetos, -2 se for um
+ * salto para dentro de uma funcao */
+static int resolve(const Chamada *c)
+{
+	char secao[MAX_NOME];
+	unsigned long deslocamento = 0;
+	int i;
+
+	if(c->alvo[0] == '.') {
+		sscanf(c->alvo, "%127[^+]+0x%lx", secao, &deslocamento);
+		i = procura_endereco(c->objeto, deslocamento);
+		return i >= 0 ? i : -2;
+	}
+
+	/* Relocacoes do x86 vem como "turn-0x4" */
+	if(strchr(c->alvo, '-')) {
+		char nome[MAX_NOME];
+
+		snprintf(nome, sizeof(nome), "%s", c->alvo);
+		*strchr(nome, '-') = 0;
+		return procura(c->objeto, nome);
+	}
+
+	return procura(c->objeto, c->alvo);
+}
+
+static int pilha(int i)
+{
+	Funcao *f = &funcoes[i];
+	int k, maior = 0;
+
+	if(f->pilha >= 0)
+		return f->pilha;
+	if(f->visitando) {
+		if(!recursiva)
+			fprintf(stderr, "orcamento: recursao passando por %s; a pilha nao tem limite\n",
+					f->nome);
+		recursiva = 1;
+		return 0;
+	}
+
+	f->visitando = 1;
+
+	if(f->indireta)
+		maior = custo_externa;
+
+	for(k = 0; k < n_chamadas; k++) {
+		int alvo, custo;
+
+		if(chamadas[k].de != i)
+			continue;
+
+		alvo = resolve(&chamadas[k]);
+		if(alvo == -2 || (alvo == i && chamadas[k].cauda))
+			continue;
+		if(alvo >= 0)
+			custo = pilha(alvo) + (chamadas[k].cauda ? 0 : custo_chamada);
+		else if(strncmp(chamadas[k].alvo, "__", 2) == 0)
+			custo = chamadas[k].cauda ? 0 : custo_chamada;
+		else
+			custo = custo_externa;
+
+		if(custo > maior) {
+			maior = custo;
+			f->proxima = alvo;
+		}
+	}
+
+	f->visitando = 0;
+	f->pilha = (f->quadro > 0 ? f->quadro : 0) + maior;
+
+	return f->pilha;
+}
+
+static void mostra_caminho(int i)
+{
+	printf("  %5d %s", funcoes[i].pilha, funcoes[i].nome);
+	for(i = funcoes[i].proxima; i >= 0; i = funcoes[i].proxima)
+		printf(" > %s", funcoes[i].nome);
+	printf("\n");
+}
+
+static void uso(const char *programa)
+{
+	fprintf(stderr, "uso: %s [-f flash] [-r ram] [-m malloc] [-e externa] [-c chamada]"
+			" tamanhos desmontado objeto.su...\n", programa);
+	exit(2);
+}
+
+int main(int argc, char **argv)
+{
+	long flash = 32768, ram = 2048, heap = 32;
+	long flash_total = 0, ram_total = 0, total_pilha;
+	char linha[1024], arquivo[1024];
+	unsigned long text, data, bss;
+	int opcao, i, k, raiz = -1, interrupcao = -1, sem_quadro = 0, falhou = 0;
+	FILE *f;
+
+	while((opcao = getopt(argc, argv, "f:r:m:e:c:")) != -1) {
+		switch(opcao) {
+		case 'f': flash = atol(optarg); break;
+		case 'r': ram = atol(optarg); break;
+		case 'm': heap = atol(optarg); break;
+		case 'e': custo_externa = atoi(optarg); break;
+		case 'c': custo_chamada = atoi(optarg); break;
+		default: uso(argv[0]);
+		}
+	}
+
+	if(argc - optind < 2)
+		uso(argv[0]);
+
+	/* Tamanhos: o ultimo eh o firmware inteiro */
+	if(!(f = fopen(argv[optind], "r"))) {
+		perror(argv[optind]);
+		return 2;
+	}
+	printf("%-24s %7s %7s %7s\n", "objeto", "flash", "data", "bss");
+	while(fgets(linha, sizeof(linha), f)) {
+		if(sscanf(linha, "%lu %lu %lu %*u %*x %1023s", &text, &data, &bss, arquivo) != 4)
+			continue;
+		printf("%-24s %7lu %7lu %7lu\n", arquivo, text + data, data, bss);
+		flash_total = text + data;
+		ram_total = data + bss;
+	}
+	fclose(f);
+
+	if(!(f = fopen(argv[optind + 1], "r"))) {
+		perror(argv[optind + 1]);
+		return 2;
+	}
+	le_desmontado(f);
+	fclose(f);
+
+	for(i = optind + 2; i < argc; i++)
+		le_su(argv[i]);
+
+	for(k = 0; k < n_chamadas; k++) {
+		int alvo = resolve(&chamadas[k]);
+
+		if(alvo >= 0 && alvo != chamadas[k].de)
+			funcoes[alvo].chamada = 1;
+	}
+
+	/* Pior raiz e pior interrupcao */
+	for(i = 0; i < n_funcoes; i++) {
+		pilha(i);
+		if(funcoes[i].quadro < 0)
+			sem_quadro++;
+
+		if(strncmp(funcoes[i].nome, "__vector_", 9) == 0) {
+			funcoes[i].pilha += custo_chamada;
+			if(interrupcao < 0 || funcoes[i].pilha > funcoes[interrupcao].pilha)
+				interrupcao = i;
+		}
+		else if(!funcoes[i].chamada) {
+			if(raiz < 0 || funcoes[i].pilha > funcoes[raiz].pilha)
+				raiz = i;
+		}
+	}
+
+	printf("\npilha no pior caso (bytes):\n");
+	total_pilha = 0;
+	if(raiz >= 0) {
+		mostra_caminho(raiz);
+		total_pilha += funcoes[raiz].pilha;
+	}
+	if(interrupcao >= 0) {
+		mostra_caminho(interrupcao);
+		total_pilha += funcoes[interrupcao].pilha;
+	}
+	else {
+		printf("  %5d interrupcoes da libpololu (estimativa)\n", custo_externa);
+		total_pilha += custo_externa;
+	}
+	if(sem_quadro)
+		printf("  %d funcoes sem .su contam so o que chamam\n", sem_quadro);
+
+	printf("\nflash: %ld de %ld bytes (sobram %ld)\n", flash_total, flash, flash - flash_total);
+	printf("ram:   %ld de %ld bytes = %ld data+bss + %ld malloc + %ld pilha (sobram %ld)\n",
+		   ram_total + heap + total_pilha, ram, ram_total, heap, total_pilha,
+		   ram - ram_total - heap - total_pilha);
+
+	if(flash_total > flash) {
+		fprintf(stderr, "orcamento: a flash estourou\n");
+		falhou = 1;
+	}
+	if(ram_total + heap + total_pilha > ram) {
+		fprintf(stderr, "orcamento: a ram estourou\n");
+		falhou = 1;
+	}
+	if(recursiva) {
+		fprintf(stderr, "orcamento: com recursao o pior caso da pilha nao vale\n");
+		falhou = 1;
+	}
+
+	return falhou;
+}
+
+// Local Variables: **
+// mode: C **
+// c-basic-offset: 4 **
+// tab-width: 4 **
+// indent-tabs-mode: t **
+// end: **
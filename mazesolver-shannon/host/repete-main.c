@@ -0,0 +1,308 @@
+/*
+ * repete-main.c
+ *
+ * Repete leituras gravadas do robo no follow_segment() e no
+ * examina_cruzamento() de verdade, no lugar dos sensores, para mudar o
+ * controle ou os limiares do cruzamento (100/200/600) e ver, sobre dados
+ * reais, se as decisoes continuam as mesmas.
+ *
+ * A entrada eh o prefixo-sensores.csv de host/telemetria-csv, capturado
+ * com o robo (ou o main-sim -T) compilado com TELEMETRIA=2. Cada trecho
+ * de leituras 'p' (PID) eh um segmento, e o trecho 'x' logo depois eh o
+ * cruzamento no fim dele; os giros ('t') so separam os segmentos. Cada
+ * segmento eh repetido com as suas proprias leituras, a partir do estado
+ * que o anterior deixou: se o codigo acabar o segmento antes, o resto do
+ * trecho eh pulado; se ainda quiser ler depois do fim, le tudo branco
+ * (o segmento acaba como beco sem saida).
+ *
+ * O get_ms() eh interceptado (-Wl,--wrap=get_ms): depois de cada leitura
+ * ele devolve o ms gravado nela, e antes da primeira de um trecho, 1 ms a
+ * menos; leituras brancas depois do fim andam 1 ms cada. Assim as
+ * distancias que o codigo integra sao as da captura. A velocidade eh a de
+ * follow_segment(): os segmentos das repeticoes, que o robo fez com
+ * follow_segment_velocidade(), integram outra distancia.
+ *
+ * Sai um CSV com uma linha por segmento: as leituras gravadas e as usadas
+ * no segmento e no cruzamento, e as saidas vistas. Com -c compara com um
+ * CSV de antes (da mesma captura) e devolve 1 se alguma linha mudou; com
+ * -p escreve os motores de cada volta do PID.
+ *
+ * Uso: ./main-repete [-c referencia.csv] [-p pid.csv] [-o saida.csv] prefixo-sensores.csv
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "hal-host.h"
+#include "follow-segment.h"
+
+#define N_SENSORES 5
+
+typedef struct Leitura {
+	unsigned long ms;
+	char fase;
+	unsigned int sensores[N_SENSORES];
+} Leitura;
+
+static Leitura *leituras = NULL;
+static long n_leituras = 0;
+
+/* O trecho que a planta esta servindo */
+static long proxima, fim;
+static long usadas;
+static char fase;
+static unsigned long agora_ms;   /* o que get_ms() devolve */
+
+static int segmento;
+static FILE *pid = NULL;
+
+static int le_leituras(const char *arquivo)
+{
+	FILE *f = fopen(arquivo, "r");
+	char linha[256];
+	long cabem = 0;
+
+	if(!f) {
+		perror(arquivo);
+		return 1;
+	}
+
+	while(fgets(linha, sizeof(linha), f)) {
+		Leitura *l;
+		unsigned int seq;
+
+		if(n_leituras == cabem) {
+			cabem = cabem ? 2 * cabem : 4096;
+			leituras = realloc(leituras, cabem * sizeof(Leitura));
+			if(!leituras) {
+				perror("realloc");
+				exit(1);
+			}
+		}
+
+		l = &leituras[n_leituras];
+		if(sscanf(linha, "%u,%lu,%c,%u,%u,%u,%u,%u", &seq, &l->ms, &l->fase,
+				  &l->sensores[0], &l->sensores[1], &l->sensores[2],
+				  &l->sensores[3], &l->sensores[4]) == 8)
+			n_leituras++;
+	}
+
+	fclose(f);
+
+	if(!n_leituras) {
+		fprintf(stderr, "%s: nenhuma leitura\n", arquivo);
+		return 1;
+	}
+
+	return 0;
+}
+
+/* Fim do trecho da fase 'f' que comeca em 'i' */
+static long fim_do_trecho(long i, char f)
+{
+	while(i < n_leituras && leituras[i].fase == f)
+		i++;
+
+	return i;
+}
+
+static void serve(long inicio, long final, char f)
+{
+	proxima = inicio;
+	fim = final;
+	fase = f;
+	usadas = 0;
+	agora_ms = inicio < final ? leituras[inicio].ms - 1 : agora_ms;
+}
+
+unsigned long __wrap_get_ms()
+{
+	return agora_ms;
+}
+
+/* Com a calibracao de 0 a 1000, a leitura bruta ja eh a calibrada */
+static void sensores(unsigned int *brutos, unsigned int timeout)
+{
+	int i;
+
+	usadas++;
+
+	if(proxima == fim) {
+		for(i = 0; i < N_SENSORES; i++)
+			brutos[i] = 0;
+		agora_ms++;
+		return;
+	}
+
+	agora_ms = leituras[proxima].ms;
+	memcpy(brutos, leituras[proxima].sensores, sizeof(leituras[proxima].sensores));
+	proxima++;
+}
+
+static void motores(int m1, int m2)
+{
+	if(pid && fase == 'p')
+		fprintf(pid, "%d,%ld,%d,%d\n", segmento, usadas, m1, m2);
+}
+
+static const PlantaHost planta = { motores, sensores, NULL, NULL };
+
+static void calibra()
+{
+	int i;
+
+	pololu_3pi_init(1000);
+	calibrate_line_sensors(IR_EMITTERS_ON);
+
+	for(i = 0; i < N_SENSORES; i++) {
+		get_line_sensors_calibrated_minimum_on()[i] = 0;
+		get_line_sensors_calibrated_maximum_on()[i] = 1000;
+	}
+}
+
+/* Conta as linhas de 'saida' (sem o cabecalho) que diferem da referencia */
+static int compara(FILE *saida, const char *arquivo)
+{
+	FILE *ref = fopen(arquivo, "r");
+	char a[256], b[256];
+	int linha = 0, diferentes = 0;
+
+	if(!ref) {
+		perror(arquivo);
+		return -1;
+	}
+
+	rewind(saida);
+	while(1) {
+		char *tem_a = fgets(a, sizeof(a), saida);
+		char *tem_b = fgets(b, sizeof(b), ref);
+
+		if(!tem_a && !tem_b)
+			break;
+
+		if(!tem_a || !tem_b || strcmp(a, b)) {
+			if(diferentes < 20)
+				fprintf(stderr, "linha %d: %s   era: %s", linha, tem_a ? a : "(nada)\n",
+						tem_b ? b : "(nada)\n");
+			diferentes++;
+		}
+		linha++;
+	}
+
+	fclose(ref);
+	return diferentes;
+}
+
+int main(int argc, char **argv)
+{
+	const char *referencia = NULL, *arquivo_saida = NULL;
+	FILE *saida;
+	long i;
+	int opcao, diferentes = 0;
+
+	while((opcao = getopt(argc, argv, "c:p:o:")) != -1) {
+		switch(opcao) {
+		case 'c':
+			referencia = optarg;
+			break;
+		case 'p':
+			pid = fopen(optarg, "w");
+			if(!pid) {
+				perror(optarg);
+				return 1;
+			}
+			fputs("segmento,leitura,m1,m2\n", pid);
+			break;
+		case 'o':
+			arquivo_saida = optarg;
+			break;
+		default:
+			optind = argc;
+			break;
+		}
+	}
+
+	if(optind != argc - 1) {
+		fprintf(stderr, "uso: %s [-c referencia.csv] [-p pid.csv] [-o saida.csv] prefixo-sensores.csv\n",
+				argv[0]);
+		return 1;
+	}
+
+	if(le_leituras(argv[optind]))
+		return 1;
+
+	saida = arquivo_saida ? fopen(arquivo_saida, "w+") : tmpfile();
+	if(!saida) {
+		perror(arquivo_saida ? arquivo_saida : "tmpfile");
+		return 1;
+	}
+	fputs("segmento,leituras,usadas,leituras_cruzamento,usadas_cruzamento,"
+		  "esquerda,frente,direita,chegada\n", saida);
+
+	calibra();
+	host_usa_planta(&planta);
+
+	for(i = 0; i < n_leituras; ) {
+		long fim_p, fim_x;
+
+		if(leituras[i].fase != 'p') {
+			i++;
+			continue;
+		}
+
+		fim_p = fim_do_trecho(i, 'p');
+		fim_x = fim_do_trecho(fim_p, 'x');
+
+		serve(i, fim_p, 'p');
+		follow_segment();
+		fprintf(saida, "%d,%ld,%ld", segmento, fim_p - i, usadas);
+
+		if(fim_x > fim_p) {
+			unsigned char found_left, found_straight, found_right;
+			char chegada;
+
+			serve(fim_p, fim_x, 'x');
+			chegada = examina_cruzamento(&found_left, &found_straight, &found_right);
+			fprintf(saida, ",%ld,%ld,%d,%d,%d,%d\n", fim_x - fim_p, usadas,
+					found_left, found_straight, found_right, chegada);
+		}
+		else {
+			fputs(",0,0,,,,\n", saida);
+		}
+
+		segmento++;
+		i = fim_x;
+	}
+
+	fprintf(stderr, "%d segmentos, %ld leituras\n", segmento, n_leituras);
+
+	if(referencia) {
+		diferentes = compara(saida, referencia);
+		if(diferentes < 0)
+			return 1;
+		fprintf(stderr, "%d linhas diferentes de %s\n", diferentes, referencia);
+	}
+
+	if(!arquivo_saida) {
+		char linha[256];
+
+		rewind(saida);
+		while(fgets(linha, sizeof(linha), saida))
+			fputs(linha, stdout);
+	}
+
+	fclose(saida);
+	if(pid)
+		fclose(pid);
+
+	return diferentes ? 1 : 0;
+}
+
+// Local Variables: **
+// mode: C **
+// c-basic-offset: 4 **
+// tab-width: 4 **
+// indent-tabs-mode: t **
+// end: **
@@ -0,0 +1,105 @@
+/*
+ * sim-main.c
+ *
+ * Roda o resolvedor inteiro (inicializa, resolve_e_aprende e
+ * resolve_e_reaprende) sobre o simulador, em tempo virtual, num labirinto
+ * (ver corrida.c para como as corridas sao medidas).
+ *
+ * Uso: ./main-sim [-v] [-a] [-e eeprom.bin [-r]] [-T serial.bin] [-n corridas] [-s semente]
+ *                 [-t limite_s] labirinto.txt
+ *
+ * Com -a o robo sabe de antemao onde fica a chegada (ver X_SAIDA em main.c).
+ * Com -e a EEPROM do robo eh lida do arquivo e gravada de volta no fim;
+ * com -r o operador aperta A na largada, e o robo repete o caminho
+ * gravado nela em vez de aprender de novo.
+ * Com -T o que o robo manda pela serial (compilado com TELEMETRIA=1 ou 2) vai
+ * para o arquivo; host/telemetria-csv decodifica.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "hal-host.h"
+#include "corrida.h"
+#include "caminho.h"
+
+/* Estado do resolvedor (main.c) */
+extern Caminho path;
+
+static Labirinto lab;
+static Resultado resultado;
+
+static void relata(const Resultado *res)
+{
+	char texto[CAMINHO_MAX + 1];
+	int i;
+
+	for(i = 0; i < res->corridas; i++)
+		printf("corrida %d: %.3f s\n", i + 1, res->tempo_s[i]);
+
+	caminho_texto(&path, 0, texto, CAMINHO_MAX);
+	printf("caminho (%u): %s\n", path.n, texto);
+
+	if(res->falha)
+		printf("falha na corrida %d: %s em %.3f s\n", res->corridas + 1,
+			   corrida_nome_falha[res->falha], res->falha_s);
+}
+
+int main(int argc, char **argv)
+{
+	unsigned long semente = 1;
+	int n_corridas = 2;
+	double limite_s = 600;
+	int opcao;
+
+	while((opcao = getopt(argc, argv, "vae:rT:n:s:t:")) != -1) {
+		switch(opcao) {
+		case 'v':
+			host_lcd_eco(1);
+			break;
+		case 'a':
+			corrida_conta_saida = 1;
+			break;
+		case 'e':
+			host_eeprom_arquivo(optarg);
+			break;
+		case 'r':
+			host_botoes_operador(BUTTON_A | BUTTON_B);
+			break;
+		case 'T':
+			host_serial_arquivo(optarg);
+			break;
+		case 'n':
+			n_corridas = atoi(optarg);
+			break;
+		case 's':
+			semente = strtoul(optarg, NULL, 0);
+			break;
+		case 't':
+			limite_s = atof(optarg);
+			break;
+		default:
+			optind = argc;
+			break;
+		}
+	}
+
+	if(optind != argc - 1 || n_corridas < 1 || n_corridas > CORRIDA_MAX) {
+		fprintf(stderr, "uso: %s [-v] [-a] [-e eeprom.bin [-r]] [-T serial.bin] [-n corridas] [-s semente] [-t limite_s] labirinto.txt\n", argv[0]);
+		return 1;
+	}
+
+	if(lab_le(&lab, argv[optind]))
+		return 1;
+
+	corrida_roda(&lab, semente, n_corridas, limite_s, &resultado, relata);
+	return 2;
+}
+
+// Local Variables: **
+// mode: C **
+// c-basic-offset: 4 **
+// tab-width: 4 **
+// indent-tabs-mode: t **
+// end: **
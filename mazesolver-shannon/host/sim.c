@@ -0,0 +1,194 @@
+/*
+ * sim.c
+ *
+ * Modelo cinematico de acionamento diferencial com motores de primeira
+ * ordem, e sensores que medem quanto da sua area esta sobre a fita.
+ */
+
+#include <math.h>
+
+#include "sim.h"
+
+void sim_inicia(Sim *sim, const Labirinto *lab, unsigned long semente)
+{
+	sim->lab = lab;
+	sim->tempo_us = 0;
+	sim->resto_us = 0;
+	sim->ruido = 20;
+	sim->semente = semente ? semente : 1;
+
+	sim_coloca_na_largada(sim);
+}
+
+void sim_coloca_na_largada(Sim *sim)
+{
+	const Labirinto *lab = sim->lab;
+	Robo *r = &sim->robo;
+
+	r->x = lab->x_inicio * lab->celula_mm;
+	r->y = lab->y_inicio * lab->celula_mm;
+	/* NORTE = 90 graus, LESTE = 0, SUL = -90, OESTE = 180 */
+	r->th = M_PI / 2 - lab->dir_inicio * M_PI / 2;
+	r->v_esq = 0;
+	r->v_dir = 0;
+	r->cmd_esq = 0;
+	r->cmd_dir = 0;
+}
+
+void sim_motores(Sim *sim, int m1, int m2)
+{
+	sim->robo.cmd_esq = m1;
+	sim->robo.cmd_dir = m2;
+}
+
+static void integra(Robo *r, double dt)
+{
+	double alvo_esq = r->cmd_esq * SIM_VEL_MAX_MM_S / 255;
+	double alvo_dir = r->cmd_dir * SIM_VEL_MAX_MM_S / 255;
+	double a = dt / (SIM_TAU_MOTOR_S + dt);
+	double v, w;
+
+	r->v_esq += (alvo_esq - r->v_esq) * a;
+	r->v_dir += (alvo_dir - r->v_dir) * a;
+
+	v = (r->v_esq + r->v_dir) / 2;
+	w = (r->v_dir - r->v_esq) / SIM_ENTRE_RODAS_MM;
+
+	r->x += v * cos(r->th + w * dt / 2) * dt;
+	r->y += v * sin(r->th + w * dt / 2) * dt;
+	r->th += w * dt;
+}
+
+void sim_avanca(Sim *sim, unsigned long us)
+{
+	sim->tempo_us += us;
+	sim->resto_us += us;
+
+	while(sim->resto_us >= SIM_PASSO_US) {
+		integra(&sim->robo, SIM_PASSO_US * 1e-6);
+		sim->resto_us -= SIM_PASSO_US;
+	}
+}
+
+/* Distancia com sinal do ponto ao retangulo (negativa dentro) */
+static double distancia_retangulo(double x, double y, double cx, double cy, double mx, double my)
+{
+	double dx = fabs(x - cx) - mx;
+	double dy = fabs(y - cy) - my;
+	double fora = hypot(dx > 0 ? dx : 0, dy > 0 ? dy : 0);
+	double dentro = dx > dy ? dx : dy;
+
+	return fora + (dentro < 0 ? dentro : 0);
+}
+
+double sim_cobertura(const Labirinto *lab, double x, double y)
+{
+	double c = lab->celula_mm;
+	double meia = SIM_FITA_MM / 2;
+	double d = 1e9;
+	int i0 = (int)floor(x / c);
+	int j0 = (int)floor(y / c);
+	int i, j;
+	double cobertura;
+
+	/* Basta olhar as fitas que saem para leste e norte dos nos em volta */
+	for(i = i0 - 1; i <= i0 + 1; i++) {
+		for(j = j0 - 1; j <= j0 + 1; j++) {
+			unsigned char s;
+			double e;
+
+			if(i < 0 || j < 0 || i >= lab->largura || j >= lab->altura)
+				continue;
+
+			s = lab->saidas[i][j];
+
+			if(s & LAB_BIT(LAB_LESTE)) {
+				e = distancia_retangulo(x, y, (i + 0.5) * c, j * c, c / 2 + meia, meia);
+				if(e < d)
+					d = e;
+			}
+			if(s & LAB_BIT(LAB_NORTE)) {
+				e = distancia_retangulo(x, y, i * c, (j + 0.5) * c, meia, c / 2 + meia);
+				if(e < d)
+					d = e;
+			}
+		}
+	}
+
+	/* Quadrado de chegada */
+	{
+		double e = distancia_retangulo(x, y, lab->x_fim * c, lab->y_fim * c,
+									   SIM_CHEGADA_MM / 2, SIM_CHEGADA_MM / 2);
+		if(e < d)
+			d = e;
+	}
+
+	cobertura = 0.5 - d / (2 * SIM_SENSOR_RAIO_MM);
+	if(cobertura < 0)
+		return 0;
+	if(cobertura > 1)
+		return 1;
+	return cobertura;
+}
+
+/* Gerador congruente: o ruido eh o mesmo para a mesma semente */
+static int aleatorio(Sim *sim, int amplitude)
+{
+	sim->semente = sim->semente * 1103515245UL + 12345UL;
+
+	if(amplitude <= 0)
+		return 0;
+
+	return (int)((sim->semente >> 16) % (2 * amplitude + 1)) - amplitude;
+}
+
+void sim_sensores(Sim *sim, unsigned int *brutos, unsigned int timeout)
+{
+	const Robo *r = &sim->robo;
+	double fx = cos(r->th), fy = sin(r->th);
+	double ex = -fy, ey = fx;      /* esquerda do robo */
+	int i;
+
+	for(i = 0; i < 5; i++) {
+		/* Sensor 0 eh o da esquerda */
+		double lado = (2 - i) * SIM_SENSOR_PASSO_MM;
+		double x = r->x + fx * SIM_SENSOR_FRENTE_MM + ex * lado;
+		double y = r->y + fy * SIM_SENSOR_FRENTE_MM + ey * lado;
+		double cobertura = sim_cobertura(sim->lab, x, y);
+		long bruto = SIM_BRUTO_BRANCO + (long)((SIM_BRUTO_PRETO - SIM_BRUTO_BRANCO) * cobertura)
+			+ aleatorio(sim, sim->ruido);
+
+		if(bruto < 0)
+			bruto = 0;
+		if(bruto > timeout)
+			bruto = timeout;
+
+		brutos[i] = bruto;
+	}
+}
+
+int sim_na_chegada(const Sim *sim)
+{
+	const Labirinto *lab = sim->lab;
+	double dx = sim->robo.x - lab->x_fim * lab->celula_mm;
+	double dy = sim->robo.y - lab->y_fim * lab->celula_mm;
+
+	/* Eixo a menos de meia celula do no de chegada */
+	return fabs(dx) < lab->celula_mm / 2.0 && fabs(dy) < lab->celula_mm / 2.0;
+}
+
+int sim_fora_da_pista(const Sim *sim)
+{
+	const Labirinto *lab = sim->lab;
+	double c = lab->celula_mm;
+
+	return sim->robo.x < -c || sim->robo.y < -c
+		|| sim->robo.x > lab->largura * c || sim->robo.y > lab->altura * c;
+}
+
+// Local Variables: **
+// mode: C **
+// c-basic-offset: 4 **
+// tab-width: 4 **
+// indent-tabs-mode: t **
+// end: **
@@ -0,0 +1,75 @@
+/*
+ * Simulador do 3pi: modelo cinematico do robo sobre um labirinto de fita
+ * e modelo dos cinco sensores QTR-RC.
+ *
+ * Nao depende da HAL: o tempo so anda quando alguem chama sim_avanca(),
+ * entao o mesmo modelo serve ao backend de host e a outras ferramentas.
+ */
+
+#ifndef SIM_H
+#define SIM_H
+
+#include "labirinto.h"
+
+/* Robo */
+#define SIM_VEL_MAX_MM_S 1000.0   /* velocidade da roda com set_motors(255) */
+#define SIM_ENTRE_RODAS_MM 80.0   /* 90 graus em 200 ms a 80, como em turn.c */
+#define SIM_TAU_MOTOR_S 0.01      /* constante de tempo dos motores */
+#define SIM_PASSO_US 500          /* passo de integracao */
+
+/* Sensores */
+#define SIM_SENSOR_FRENTE_MM 40.0 /* distancia dos sensores ao eixo */
+#define SIM_SENSOR_PASSO_MM 10.0  /* distancia entre sensores vizinhos */
+#define SIM_SENSOR_RAIO_MM 3.0    /* raio da area vista por um sensor */
+#define SIM_BRUTO_BRANCO 150      /* descarga no branco, em ticks de 0.4 us */
+#define SIM_BRUTO_PRETO 1400      /* descarga sobre a fita */
+
+/* Pista */
+#define SIM_FITA_MM 19.0          /* fita isolante de 3/4" */
+#define SIM_CHEGADA_MM 60.0       /* lado do quadrado de chegada */
+
+typedef struct Robo {
+	double x;        /* posicao do eixo, mm */
+	double y;
+	double th;       /* orientacao em rad, 0 = leste, anti-horario */
+	double v_esq;    /* velocidade real das rodas, mm/s */
+	double v_dir;
+	int cmd_esq;     /* ultimo set_motors() */
+	int cmd_dir;
+} Robo;
+
+typedef struct Sim {
+	const Labirinto *lab;
+	Robo robo;
+	unsigned long long tempo_us;
+	unsigned long resto_us;
+	unsigned int ruido;        /* amplitude do ruido dos sensores, em ticks */
+	unsigned long semente;
+} Sim;
+
+void sim_inicia(Sim *sim, const Labirinto *lab, unsigned long semente);
+
+/* Poe o robo parado no no de largada, olhando para a direcao de largada */
+void sim_coloca_na_largada(Sim *sim);
+
+void sim_motores(Sim *sim, int m1, int m2);
+void sim_avanca(Sim *sim, unsigned long us);
+
+/* Leitura bruta dos sensores na pose atual, limitada pelo timeout */
+void sim_sensores(Sim *sim, unsigned int *brutos, unsigned int timeout);
+
+/* Fracao (0 a 1) de um sensor no ponto (x,y) que ve fita */
+double sim_cobertura(const Labirinto *lab, double x, double y);
+
+/* Pose em coordenadas da grade de nos */
+int sim_na_chegada(const Sim *sim);
+int sim_fora_da_pista(const Sim *sim);
+
+#endif
+
+// Local Variables: **
+// mode: C **
+// c-basic-offset: 4 **
+// tab-width: 4 **
+// indent-tabs-mode: t **
+// end: **
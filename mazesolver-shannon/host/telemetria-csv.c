@@ -0,0 +1,216 @@
+/*
+ * telemetria-csv.c
+ *
+ * Decodifica uma captura da serial do robo (telemetria.h) em CSV:
+ * prefixo-controle.csv, uma linha por volta do PID,
+ * prefixo-sensores.csv, uma linha por leitura (TELEMETRIA=2; eh a
+ * entrada do main-repete),
+ * prefixo-cruzamentos.csv, uma linha por cruzamento, e
+ * prefixo-caixa-preta.csv, os eventos da caixa preta (caixa-preta.h).
+ * A captura pode vir de um adaptador USB-serial (ex.: stty -F
+ * /dev/ttyUSB0 250000 raw; cat /dev/ttyUSB0 > captura.bin) ou do
+ * simulador (main-sim -T).
+ *
+ * Bytes que nao formam um quadro com a soma certa sao pulados ate a
+ * proxima sincronia. O ms dos quadros tem 16 bits; aqui ele vira o tempo
+ * desde o primeiro quadro, supondo que nunca se passa um minuto sem
+ * quadro. Os quadros que faltam na sequencia (perdidos pelo robo com a
+ * fila cheia ou corrompidos no caminho) sao contados no fim.
+ *
+ * Uso: ./host/telemetria-csv [-o prefixo] captura.bin
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "telemetria.h"
+
+static unsigned int le_16(const unsigned char *p)
+{
+	return p[0] | (p[1] << 8);
+}
+
+static int le_16_com_sinal(const unsigned char *p)
+{
+	return (short)le_16(p);
+}
+
+/* Quantos bytes de dados tem um quadro do tipo; 0 se nao existir */
+static int dados_do_tipo(unsigned char tipo)
+{
+	if(tipo == TELEMETRIA_CONTROLE)
+		return TELEMETRIA_DADOS_CONTROLE;
+	if(tipo == TELEMETRIA_CRUZAMENTO)
+		return TELEMETRIA_DADOS_CRUZAMENTO;
+	if(tipo == TELEMETRIA_SENSORES)
+		return TELEMETRIA_DADOS_SENSORES;
+	if(tipo == TELEMETRIA_CAIXA_PRETA)
+		return TELEMETRIA_DADOS_CAIXA_PRETA;
+
+	return 0;
+}
+
+static FILE *abre(const char *prefixo, const char *nome, const char *cabecalho)
+{
+	char arquivo[1024];
+	FILE *f;
+
+	snprintf(arquivo, sizeof(arquivo), "%s-%s.csv", prefixo, nome);
+	f = fopen(arquivo, "w");
+	if(!f) {
+		perror(arquivo);
+		exit(1);
+	}
+	fputs(cabecalho, f);
+
+	return f;
+}
+
+int main(int argc, char **argv)
+{
+	const char *prefixo = "telemetria";
+	unsigned char buffer[4096], *q;
+	FILE *entrada, *controle, *sensores, *cruzamentos, *caixa_preta;
+	size_t n = 0, lidos, i;
+	unsigned long quadros = 0, descartados = 0, perdidos = 0, ms = 0;
+	unsigned int ms_anterior = 0;
+	int sequencia = -1, opcao, tem_ms = 0;
+
+	while((opcao = getopt(argc, argv, "o:")) != -1) {
+		switch(opcao) {
+		case 'o':
+			prefixo = optarg;
+			break;
+		default:
+			optind = argc;
+			break;
+		}
+	}
+
+	if(optind != argc - 1) {
+		fprintf(stderr, "uso: %s [-o prefixo] captura.bin\n", argv[0]);
+		return 1;
+	}
+
+	entrada = fopen(argv[optind], "rb");
+	if(!entrada) {
+		perror(argv[optind]);
+		return 1;
+	}
+
+	controle = abre(prefixo, "controle",
+					"seq,ms,s0,s1,s2,s3,s4,posicao,p,i,d,m1,m2\n");
+	sensores = abre(prefixo, "sensores", "seq,ms,fase,s0,s1,s2,s3,s4\n");
+	cruzamentos = abre(prefixo, "cruzamentos",
+					   "seq,ms,esquerda,frente,direita,acao,x,y,orientacao\n");
+	caixa_preta = abre(prefixo, "caixa-preta",
+					   "ms,evento,posicao,m1,m2,esquerda,frente,direita,x,y\n");
+
+	do {
+		lidos = fread(buffer + n, 1, sizeof(buffer) - n, entrada);
+		n += lidos;
+		i = 0;
+
+		while(n - i >= TELEMETRIA_MOLDURA) {
+			unsigned char soma = 0;
+			int dados, k;
+
+			q = buffer + i;
+			dados = dados_do_tipo(q[1]);
+
+			if(q[0] != TELEMETRIA_SINCRONIA || !dados) {
+				i++;
+				descartados++;
+				continue;
+			}
+			if(n - i < (size_t)dados + TELEMETRIA_MOLDURA)
+				break;
+
+			for(k = 1; k < dados + 3; k++)
+				soma += q[k];
+			if(soma != q[dados + 3]) {
+				i++;
+				descartados++;
+				continue;
+			}
+
+			if(sequencia >= 0)
+				perdidos += (q[2] - sequencia - 1) & 0xff;
+			sequencia = q[2];
+
+			quadros++;
+
+			/* A caixa preta tem o ms de quando o evento foi guardado */
+			if(q[1] == TELEMETRIA_CAIXA_PRETA) {
+				const unsigned char *d = q + 5;
+
+				if(d[0] == 'c')
+					fprintf(caixa_preta, "%u,c,%u,%d,%d,,,,,\n", le_16(q + 3), d[1] * 16,
+							(signed char)d[2] * 2, (signed char)d[3] * 2);
+				else
+					fprintf(caixa_preta, "%u,%c,,,,%d,%d,%d,%d,%d\n", le_16(q + 3), d[0],
+							d[1] & 1, (d[1] >> 1) & 1, (d[1] >> 2) & 1,
+							(signed char)d[2], (signed char)d[3]);
+
+				i += dados + TELEMETRIA_MOLDURA;
+				continue;
+			}
+
+			if(tem_ms)
+				ms += (le_16(q + 3) - ms_anterior) & 0xffff;
+			ms_anterior = le_16(q + 3);
+			tem_ms = 1;
+
+			if(q[1] == TELEMETRIA_CONTROLE) {
+				const unsigned char *d = q + 5;
+
+				fprintf(controle, "%u,%lu,%u,%u,%u,%u,%u,%u,%d,%d,%d,%d,%d\n",
+						q[2], ms, d[0] * 4, d[1] * 4, d[2] * 4, d[3] * 4, d[4] * 4,
+						le_16(d + 5), le_16_com_sinal(d + 7), le_16_com_sinal(d + 9),
+						le_16_com_sinal(d + 11), le_16_com_sinal(d + 13),
+						le_16_com_sinal(d + 15));
+			}
+			else if(q[1] == TELEMETRIA_SENSORES) {
+				const unsigned char *d = q + 5;
+
+				fprintf(sensores, "%u,%lu,%c,%u,%u,%u,%u,%u\n", q[2], ms, d[0],
+						le_16(d + 1), le_16(d + 3), le_16(d + 5), le_16(d + 7), le_16(d + 9));
+			}
+			else {
+				const unsigned char *d = q + 5;
+
+				fprintf(cruzamentos, "%u,%lu,%d,%d,%d,%c,%d,%d,%c\n",
+						q[2], ms, d[0] & 1, (d[0] >> 1) & 1, (d[0] >> 2) & 1,
+						d[1], (signed char)d[2], (signed char)d[3], d[4]);
+			}
+
+			i += dados + TELEMETRIA_MOLDURA;
+		}
+
+		/* O que sobrou eh o comeco do proximo quadro */
+		memmove(buffer, buffer + i, n - i);
+		n -= i;
+	} while(lidos);
+
+	descartados += n;
+
+	fprintf(stderr, "%lu quadros, %lu faltando na sequencia, %lu bytes descartados\n",
+			quadros, perdidos, descartados);
+
+	fclose(entrada);
+	fclose(controle);
+	fclose(sensores);
+	fclose(cruzamentos);
+	fclose(caixa_preta);
+
+	return 0;
+}
+
+// Local Variables: **
+// mode: C **
+// c-basic-offset: 4 **
+// tab-width: 4 **
+// indent-tabs-mode: t **
+// end: **
@@ -4,13 +4,19 @@
 * O Robô percorrerá o labirinto salvando seus erros e acertos, ao final, quando colocado novamente ele já saberá o menor cmainho para saida 
 * Autor: Leonardo Alves de Melo */
 
-/* Biblioteca padrao do 3pi */
-#include <pololu/3pi.h>
+/* Biblioteca padrao do 3pi (ou o backend de host) */
+#include "hal.h"
 
 /* Outras libs */
-#include <avr/pgmspace.h>
 #include "bargraph.h"
 #include "follow-segment.h"
+#include "turn.h"
+#include "mapa.h"
+#include "theseus.h"
+#include "memoria.h"
+#include "caminho.h"
+#include "telemetria.h"
+#include "caixa-preta.h"
 
 /* Sera printado na tela LCD ao iniciar o programa*/
 const char welcome_line1[] PROGMEM = " GER";
@@ -24,12 +30,6 @@ const char go[] PROGMEM = "L16 cdegreg4";
 
 #define NULL 0
 
-/* Definimos a direcao do robo */
-#define NORTE 'n'
-#define LESTE 'l'
-#define SUL 's'
-#define OESTE 'o'
-
 #define HORARIO 0
 #define ANTI_HORARIO 1
 
@@ -44,21 +44,32 @@ const char go[] PROGMEM = "L16 cdegreg4";
 
 #define ORIENTACAO_INICIAL NORTE
 
-/* Definicoes sobre o tamanho do mapa */
-#define LARGURA 11
-#define ALTURA 11
-#define TAM_MAPA LARGURA * ALTURA
+/* Posicao da chegada, em celulas a partir da largada, se ja se sabe onde
+ * ela fica: a exploracao vai na direcao dela. Sem isso ela so eh conhecida
+ * depois da primeira corrida. */
+//#define X_SAIDA 10
+//#define Y_SAIDA 10
 
-int ponte;
+/* Velocidades da repeticao: como ja sabemos a proxima acao, o segmento
+ * que termina num 'S' pode ser feito rapido; o que termina numa curva
+ * chega na velocidade de sempre. A rampa parte da velocidade com que o
+ * robo sai do cruzamento. */
+#define VELOCIDADE_RETA 120
+#define VELOCIDADE_CURVA 60
+#define VELOCIDADE_SAIDA 40
 
-/* guardamos o caminho em um vetor de caracter */
-char path[TAM_MAPA] = "";
 
-/* Guarda as antigas posicoes do caminho para no caso de ele mudar */
-char antigo_path[TAM_MAPA] = "";
+int ponte;
+
+/* guardamos o caminho com 2 bits por passo; path.n eh o tamanho */
+Caminho path;
 
-/* Cada local descoberto aumentamos o tamanho do caminho */
-unsigned char path_length = 0;
+/* Para cada passo do caminho, a distancia do segmento que chega nele,
+ * estimada pelos comandos de motor (ver follow_segment_distancia).
+ * Zero quando nao se sabe; simplify_path mantem a do primeiro segmento.
+ * A do passo seguinte ao ultimo eh escrita antes de caminho_acrescenta(),
+ * por isso o um a mais. */
+unsigned int distancia[CAMINHO_MAX + 1];
 
 /* Vetor 2D que guarda a posicao do robo no mapa e/ou a posicao da saida */
 typedef struct Mapa {
@@ -66,25 +77,159 @@ typedef struct Mapa {
 	int y;
 } Mapa;
 
-/* Neste struct está o percurso certo para sair do labirinto antes dele mudar */
+/* Uma celula do percurso: o mapa vai de -MAPA_MAX a MAPA_MAX, cabe num char */
+typedef struct Celula {
+	signed char x;
+	signed char y;
+} Celula;
+
+/* Neste struct está o percurso certo para sair do labirinto antes dele mudar.
+ * A acao de cada passo sai de 'saida' e da 'saida' do passo anterior. */
 typedef struct Percurso {	
-	char orientacao;
-	unsigned char dir; 
-	Mapa posicao;
+	char saida;                 /* orientacao com que sai do cruzamento */
+	unsigned int distancia;
+	Celula posicao;
 } Percurso;
 
 /* É o que o robo se lembra */
 Percurso percurso[TAM_MAPA/2];
 
-/* Local onde o robo esta no mapa */
+/* Local onde o robo esta no mapa, em celulas da grade do labirinto */
 Mapa local_robo;
 
+/* Local onde está a saida */
+Mapa local_saida;
+
+/* Se local_saida ja vale */
+char saida_conhecida = 0;
+
 /* Variavel que guarda a orientacao do 3pi */
 char orientacao = ORIENTACAO_INICIAL;
 
 /* guarda o tamanho para o novo percurso */
 int tam_percurso_memorizado = 0;
 
+/* Na largada o operador pediu para repetir o que esta na EEPROM */
+char usa_memoria = 0;
+
+/* Timeout dos sensores, em ticks de 0.4 us: o de sempre ate calibrar.
+ * Depois fica o maior maximo calibrado com folga de um quarto, porque o
+ * QTR-RC espera o timeout inteiro em toda leitura. */
+#define TIMEOUT_SENSORES 2000
+#define TIMEOUT_MINIMO 250
+
+/* Passa a usar a calibracao dada, com o timeout tirado dela */
+void aplica_calibracao(unsigned int *minimo, unsigned int *maximo) {
+
+	unsigned int *minimo_on, *maximo_on;
+	unsigned int timeout = 0;
+	int i;
+
+	for(i = 0; i < 5; i++) {
+		if(maximo[i] > timeout) {
+			timeout = maximo[i];
+		}
+	}
+	timeout += timeout / 4;
+	if(timeout < TIMEOUT_MINIMO) {
+		timeout = TIMEOUT_MINIMO;
+	}
+	if(timeout > TIMEOUT_SENSORES) {
+		timeout = TIMEOUT_SENSORES;
+	}
+
+	// So iniciando de novo se troca o timeout. Isso zera os ponteiros
+	// da calibracao sem liberar os vetores, que a libpololu so cria na
+	// primeira chamada a calibrate_line_sensors(): por isso ninguem a
+	// chama antes daqui, e os vetores sao alocados uma vez so.
+	pololu_3pi_init(timeout);
+	calibrate_line_sensors(IR_EMITTERS_ON);
+	minimo_on = get_line_sensors_calibrated_minimum_on();
+	maximo_on = get_line_sensors_calibrated_maximum_on();
+
+	for(i = 0; i < 5; i++) {
+		minimo_on[i] = minimo[i];
+		maximo_on[i] = maximo[i];
+	}
+}
+
+/* Como calibrate_line_sensors(), mas nos vetores dados, sem os da
+ * libpololu: dez leituras, e so vale o extremo que se repetiu em todas */
+void calibra_leitura(unsigned int *minimo, unsigned int *maximo) {
+
+	unsigned int sensors[5], menor[5], maior[5];
+	int i, j;
+
+	for(j = 0; j < 10; j++) {
+		read_line_sensors(sensors, IR_EMITTERS_ON);
+		for(i = 0; i < 5; i++) {
+			if(j == 0 || sensors[i] > maior[i]) {
+				maior[i] = sensors[i];
+			}
+			if(j == 0 || sensors[i] < menor[i]) {
+				menor[i] = sensors[i];
+			}
+		}
+	}
+
+	for(i = 0; i < 5; i++) {
+		if(menor[i] > maximo[i]) {
+			maximo[i] = menor[i];
+		}
+		if(maior[i] < minimo[i]) {
+			minimo[i] = maior[i];
+		}
+	}
+}
+
+/* Diagnostico: quanto leva um read_line() com o timeout de agora */
+void mostra_tempo_de_leitura() {
+
+	unsigned int sensors[5];
+	unsigned long inicio = get_ticks();
+	int i;
+
+	for(i = 0; i < 10; i++) {
+		read_line(sensors, IR_EMITTERS_ON);
+	}
+
+	// Dez leituras em ticks de 0.4 us
+	lcd_goto_xy(0,1);
+	print_long((get_ticks() - inicio) / 25);
+	print("us");
+}
+
+/* Usa a calibracao gravada na EEPROM se a leitura de agora, com o robo
+ * sobre a linha de largada, cabe nela: cada sensor dentro da faixa
+ * gravada, com folga de um quarto dela, e a linha embaixo de algum */
+char usa_calibracao(unsigned int *minimo, unsigned int *maximo) {
+
+	unsigned int sensors[5];
+	char linha = 0;
+	int i;
+
+	read_line_sensors(sensors, IR_EMITTERS_ON);
+
+	for(i = 0; i < 5; i++) {
+		unsigned int folga = (maximo[i] - minimo[i]) / 4;
+
+		if(maximo[i] <= minimo[i] || sensors[i] + folga < minimo[i] || sensors[i] > maximo[i] + folga) {
+			return 0;
+		}
+		if(sensors[i] > (minimo[i] + maximo[i]) / 2) {
+			linha = 1;
+		}
+	}
+
+	if(!linha) {
+		return 0;
+	}
+
+	aplica_calibracao(minimo, maximo);
+
+	return 1;
+}
+
 /* Inicializa o robo, mostra uma mensagem, calibra os sensores e toca uma musica */
 /* Este codigo eh do 3pi */
 void inicializa() {
@@ -95,24 +240,37 @@ void inicializa() {
 	// This must be called at the beginning of 3pi code, to set up the
 	// sensors.  We use a value of 2000 for the timeout, which
 	// corresponds to 2000*0.4 us = 0.8 ms on our 20 MHz processor.
-	pololu_3pi_init(2000);
+	// Depois de calibrar, aplica_calibracao() diminui o timeout.
+	pololu_3pi_init(TIMEOUT_SENSORES);
+	telemetria_inicia();
 	load_custom_characters(); // load the custom characters
-	
-	// Play welcome music and display a message
-	print_from_program_space(welcome_line1);
-	lcd_goto_xy(0,1);
-	print_from_program_space(welcome_line2);
-	play_from_program_space(welcome);
-	delay_ms(1000);
 
-	clear();
-	print_from_program_space(demo_name_line1);
-	lcd_goto_xy(0,1);
-	print_from_program_space(demo_name_line2);
-	delay_ms(1000);
+	/* Com a calibracao na EEPROM a largada eh rapida: sem as telas de
+	 * abertura, sem musica e, se os sensores conferirem, sem calibrar */
+	unsigned int minimo[5], maximo[5];
+	char largada_rapida = memoria_le_calibracao(minimo, maximo);
 
-	// Display battery voltage and wait for button press
-	while(!button_is_pressed(BUTTON_B))
+	if(!largada_rapida)
+	{
+		// Play welcome music and display a message
+		print_from_program_space(welcome_line1);
+		lcd_goto_xy(0,1);
+		print_from_program_space(welcome_line2);
+		play_from_program_space(welcome);
+		delay_ms(1000);
+
+		clear();
+		print_from_program_space(demo_name_line1);
+		lcd_goto_xy(0,1);
+		print_from_program_space(demo_name_line2);
+		delay_ms(1000);
+	}
+
+	// Display battery voltage and wait for button press.  Se a EEPROM
+	// tem um caminho, A vai direto para a repeticao.
+	char tem_memoria = memoria_valida();
+
+	while(1)
 	{
 		int bat = read_battery_millivolts();
 
@@ -120,18 +278,45 @@ void inicializa() {
 		print_long(bat);
 		print("mV");
 		lcd_goto_xy(0,1);
-		print("Press B");
+		if(tem_memoria && get_ms() % 2000 >= 1000)
+			print("A:repete");
+		else
+			print("Press B");
+
+		if(tem_memoria && button_is_pressed(BUTTON_A))
+		{
+			usa_memoria = 1;
+			break;
+		}
+		if(button_is_pressed(BUTTON_B))
+			break;
 
 		delay_ms(100);
 	}
 
 	// Always wait for the button to be released so that 3pi doesn't
 	// start moving until your hand is away from it.
-	wait_for_button_release(BUTTON_B);
+	wait_for_button_release(BUTTON_A | BUTTON_B);
+
+	if(largada_rapida && usa_calibracao(minimo, maximo))
+	{
+		// So o tempo de tirar a mao.
+		clear();
+		print("GER!");
+		mostra_tempo_de_leitura();
+		delay_ms(500);
+		return;
+	}
+
 	delay_ms(1000);
 
 	// Auto-calibration: turn right and left while calibrating the
-	// sensors.
+	// sensors.  Os extremos ficam em minimo[] e maximo[] ate
+	// aplica_calibracao().
+	for(counter = 0; counter < 5; counter++) {
+		minimo[counter] = TIMEOUT_SENSORES;
+		maximo[counter] = 0;
+	}
 	for(counter=0;counter<80;counter++)
 	{
 		if(counter < 20 || counter >= 60)
@@ -140,11 +325,8 @@ void inicializa() {
 			set_motors(-40,40);
 
 		// This function records a set of sensor readings and keeps
-		// track of the minimum and maximum values encountered.  The
-		// IR_EMITTERS_ON argument means that the IR LEDs will be
-		// turned on during the reading, which is usually what you
-		// want.
-		calibrate_line_sensors(IR_EMITTERS_ON);
+		// track of the minimum and maximum values encountered.
+		calibra_leitura(minimo, maximo);
 
 		// Since our counter runs to 80, the total delay will be
 		// 80*20 = 1600 ms.
@@ -152,6 +334,9 @@ void inicializa() {
 	}
 	set_motors(0,0);
 
+	/* O timeout passa a ser o da superficie em que calibrou */
+	aplica_calibracao(minimo, maximo);
+
 	// Display calibrated values as a bar graph.
 	while(!button_is_pressed(BUTTON_B))
 	{
@@ -172,9 +357,13 @@ void inicializa() {
 	}
 	wait_for_button_release(BUTTON_B);
 
+	/* A proxima largada pode usar esta calibracao */
+	memoria_grava_calibracao(minimo, maximo);
+
 	clear();
 
 	print("GER!");		
+	mostra_tempo_de_leitura();
 
 	// Play music and wait for it to finish before we start driving.
 	play_from_program_space(go);
@@ -182,33 +371,100 @@ void inicializa() {
 
 }
 
+/* Avisa onde fica a chegada antes de ter passado por ela */
+void define_saida(int x, int y) {
+
+	local_saida.x = x;
+	local_saida.y = y;
+	saida_conhecida = 1;
+}
+
+/* Volta ao fim da ultima corrida gravada na EEPROM */
+char le_memoria() {
+
+	int x, y;
+
+	if(!memoria_le(&path, distancia, &x, &y)) {
+		return 0;
+	}
+
+	define_saida(x, y);
+
+	return 1;
+}
+
 /* Configuracoes inicial do local do robo e da saida */
 void inicializa_mapa() {
 
 	local_robo.x = X_ROBO;
 	local_robo.y = Y_ROBO;
+
+	mapa_limpa();
+	mapa_marca_visitado(X_ROBO, Y_ROBO);
+#ifdef THESEUS
+	theseus_limpa(X_ROBO, Y_ROBO, ORIENTACAO_INICIAL);
+#endif
+
+#ifdef X_SAIDA
+	define_saida(X_SAIDA, Y_SAIDA);
+#endif
 }
 
 void display_path()
 {
-	// Set the last character of the path to a 0 so that the print()
-	// function can find the end of the string.  This is how strings
-	// are normally terminated in C.
-	path[path_length] = 0;
+	// Uma linha do LCD por vez, em texto terminado em 0 para o print().
+	char texto[9];
 
 	clear();
-	print(path);
+	caminho_texto(&path, 0, texto, 8);
+	print(texto);
 
-	if(path_length > 8)
+	if(path.n > 8)
 	{
 		lcd_goto_xy(0,1);
-		print(path+8);
+		caminho_texto(&path, 8, texto, 8);
+		print(texto);
 	}
 }
 
-/* Funcao que testa um caminho */
+/* Acao que leva da orientacao 'de' para 'para' */
+char acao_entre(char de, char para) {
+
+	if(mapa_vira(de, 'L') == para) {
+		return 'L';
+	}
+	else if(mapa_vira(de, 'R') == para) {
+		return 'R';
+	}
+	else if(mapa_vira(de, 'B') == para) {
+		return 'B';
+	}
+
+	return 'S';
+}
+
+/* Acao que leva da orientacao atual para 'nova_orientacao' */
+char direcao_para(char nova_orientacao) {
+
+	return acao_entre(orientacao, nova_orientacao);
+}
+
+/* Funcao que testa um caminho: com o mapa, explora primeiro o que ainda
+ * nao viu, indo na direcao da saida se ela for conhecida; com THESEUS,
+ * faz a busca em profundidade de theseus.c */
 char select_turn(unsigned char found_left, unsigned char found_straight, unsigned char found_right)
 {
+#ifdef THESEUS
+	char nova_orientacao = theseus_escolhe(local_robo.x, local_robo.y, orientacao,
+										   found_left, found_straight, found_right);
+#else
+	char nova_orientacao = mapa_explora(local_robo.x, local_robo.y, orientacao, saida_conhecida,
+										local_saida.x, local_saida.y);
+#endif
+
+	if(nova_orientacao)
+		return direcao_para(nova_orientacao);
+
 	// Make a decision about how to turn.  The following code
 	// implements a left-hand-on-the-wall strategy, where we always
 	// turn as far to the left as possible.
@@ -226,14 +482,14 @@ char select_turn(unsigned char found_left, unsigned char found_straight, unsigne
 void simplify_path()
 {
 	// only simplify the path if the second-to-last turn was a 'B'
-	if(path_length < 3 || path[path_length-2] != 'B')
+	if(path.n < 3 || caminho_passo(&path, path.n-2) != 'B')
 		return;
 
 	int total_angle = 0;
 	int i;
 	for(i=1;i<=3;i++)
 	{
-		switch(path[path_length-i])
+		switch(caminho_tira(&path))
 		{
 		case 'R':
 			total_angle += 90;
@@ -250,25 +506,25 @@ void simplify_path()
 	// Get the angle as a number between 0 and 360 degrees.
 	total_angle = total_angle % 360;
 
-	// Replace all of those turns with a single one.
+	// Replace all of those turns with a single one.  distancia[] do
+	// passo que fica continua como esta: o segmento que chega no
+	// cruzamento eh o mesmo, e a ida e volta ao beco some.
+	// The path is now two steps shorter.
 	switch(total_angle)
 	{
 	case 0:
-		path[path_length - 3] = 'S';
+		caminho_acrescenta(&path, 'S');
 		break;
 	case 90:
-		path[path_length - 3] = 'R';
+		caminho_acrescenta(&path, 'R');
 		break;
 	case 180:
-		path[path_length - 3] = 'B';
+		caminho_acrescenta(&path, 'B');
 		break;
 	case 270:
-		path[path_length - 3] = 'L';
+		caminho_acrescenta(&path, 'L');
 		break;
 	}
-
-	// The path is now two steps shorter.
-	path_length -= 2;
 }
 
 
@@ -328,6 +584,9 @@ void troca_orientacao(char nova_orientacao) {
 
 
 
+void anda_segmento();
+void vira(char dir);
+
 /* Tenta achar a alguma saida para aquela posicao */
 void resolve_e_aprende() {
 
@@ -337,12 +596,9 @@ void resolve_e_aprende() {
 		// FIRST MAIN LOOP BODY  
 		follow_segment();
 
-		// Drive straight a bit.  This helps us in case we entered the
-		// intersection at an angle.
-		// Note that we are slowing down - this prevents the robot
-		// from tipping forward too much.
-		set_motors(50,50);
-		delay_ms(50);
+		unsigned int dist = follow_segment_distancia();
+
+		anda_segmento();
 
 		// These variables record whether the robot has seen a line to the
 		// left, straight ahead, and right, whil examining the current
@@ -351,49 +607,31 @@ void resolve_e_aprende() {
 		unsigned char found_straight=0;
 		unsigned char found_right=0;
 
-		// Now read the sensors and check the intersection type.
-		unsigned int sensors[5];
-		read_line(sensors,IR_EMITTERS_ON);
-
-		// Check for left and right exits.
-		if(sensors[0] > 100)
-			found_left = 1;
-		if(sensors[4] > 100)
-			found_right = 1;
-
-		// Drive straight a bit more - this is enough to line up our
-		// wheels with the intersection.
-		set_motors(40,40);
-		delay_ms(200);
-
-		// Check for a straight exit.
-		read_line(sensors,IR_EMITTERS_ON);
-		if(sensors[1] > 200 || sensors[2] > 200 || sensors[3] > 200)
-			found_straight = 1;
-
-		// Check for the ending spot.
-		// If all three middle sensors are on dark black, we have
-		// solved the maze.
-		if(sensors[1] > 600 && sensors[2] > 600 && sensors[3] > 600) {
+		// Examina o cruzamento sem parar. Check for the ending spot.
+		if(examina_cruzamento(&found_left, &found_straight, &found_right)) {
 			/* Tocar buzzer aqui */
+			local_saida = local_robo;
+			saida_conhecida = 1;
 			break;
 		}
 
+		/* Anota no mapa as saidas deste cruzamento */
+		mapa_registra_cruzamento(local_robo.x, local_robo.y, orientacao,
+								 found_left, found_straight, found_right);
+
 		// Intersection identification is complete.
 		// If the maze has been solved, we can follow the existing
 		// path.  Otherwise, we need to learn the solution.
 		unsigned char dir = select_turn(found_left, found_straight, found_right);
 
 		// Make the turn indicated by the path.
-		turn(dir);
+		vira(dir);
+		troca_orientacao(dir);
 
-		// Store the intersection in the path variable.
-		path[path_length] = dir;
-		path_length ++;
-
-		// You should check to make sure that the path_length does not
-		// exceed the bounds of the array.  We'll ignore that in this
-		// example.
+		// Store the intersection in the path variable.  Se o caminho
+		// encher, caminho_acrescenta() ignora o passo.
+		distancia[path.n] = dist;
+		caminho_acrescenta(&path, dir);
 
 		// Simplify the learned path.
 		simplify_path();
@@ -426,23 +664,25 @@ int caminho_certo(unsigned char esq, unsigned char frente, unsigned char dir, ch
 	return retorno; 
 }
 
-/* Escreve na Struct que guarda o caminho */
-void acrescenta_caminho(int x, int y, int i) {	
+/* Escreve na Struct que guarda o caminho; 'local' anda (x,y) */
+void acrescenta_caminho(Mapa *local, int x, int y, int i) {	
 
-	if(tam_percurso_memorizado == 0) {
-		percurso[tam_percurso_memorizado].orientacao = orientacao;
-		percurso[tam_percurso_memorizado].dir = path[i];
-		percurso[tam_percurso_memorizado].posicao.x = x;	
-		percurso[tam_percurso_memorizado].posicao.y = y;
-	}
-	else {
-		percurso[tam_percurso_memorizado].orientacao = orientacao;
-		percurso[tam_percurso_memorizado].dir = path[i];
-		percurso[tam_percurso_memorizado].posicao.x = percurso[tam_percurso_memorizado - 1].posicao.x + x;	
-		percurso[tam_percurso_memorizado].posicao.y = percurso[tam_percurso_memorizado - 1].posicao.y + y;
+	local->x += x;
+	local->y += y;
+
+	if(tam_percurso_memorizado >= TAM_MAPA/2) {
+		return;
 	}
+
+	percurso[tam_percurso_memorizado].saida = mapa_vira(orientacao, caminho_passo(&path, i));
+	percurso[tam_percurso_memorizado].distancia = distancia[i];
+	percurso[tam_percurso_memorizado].posicao.x = local->x;
+	percurso[tam_percurso_memorizado].posicao.y = local->y;
 	
 
+	mapa_marca_visitado(percurso[tam_percurso_memorizado].posicao.x,
+						percurso[tam_percurso_memorizado].posicao.y);
+
 	/* Tem mais um para memorizar */
 	tam_percurso_memorizado++;
 
@@ -453,55 +693,77 @@ void guarda_caminho_anterior(int pos) {
 
 	int i;
 	char orientacao_antiga = orientacao;
+	Mapa local = local_robo;
+
+	/* O passo 'pos' era num cruzamento a distancia[pos] do anterior. Se ele
+	 * sumiu, o robo passou direto e parou mais adiante; se apareceu outro
+	 * no meio, parou antes. O caminho antigo sai de onde ele estava. */
+	if(pos < path.n && distancia[pos]) {
+		int a_mais = follow_segment_celulas() - follow_segment_celulas_de(distancia[pos]);
+
+		if(orientacao == NORTE)
+			local.y -= a_mais;
+		else if(orientacao == LESTE)
+			local.x -= a_mais;
+		else if(orientacao == OESTE)
+			local.x += a_mais;
+		else if(orientacao == SUL)
+			local.y += a_mais;
+	}
+
+	for(i = pos; i < path.n; i++) {
+		char dir = caminho_passo(&path, i);
+
+		/* Celulas ate o proximo cruzamento, pelo segmento que chega nele */
+		int n = 1;
+		if(i + 1 < path.n && distancia[i + 1]) {
+			n = follow_segment_celulas_de(distancia[i + 1]);
+		}
 
-	for(i = pos; i < path_length; i++) {
-		if(path[i] == 'S') {
+		if(dir == 'S') {
 			if(orientacao == NORTE) {
-				acrescenta_caminho(0,1, i);
+				acrescenta_caminho(&local, 0, n, i);
 			}
 			else if(orientacao == LESTE) {
-				acrescenta_caminho(1,0, i);
+				acrescenta_caminho(&local, n, 0, i);
 			}
 			else if(orientacao == OESTE) {
-				acrescenta_caminho(-1,0, i);
+				acrescenta_caminho(&local, -n, 0, i);
 			}
 			else if(orientacao == SUL) {
-				acrescenta_caminho(0,-1, i);
+				acrescenta_caminho(&local, 0, -n, i);
 			}
 		}
-		else if(path[i] == 'R') {
+		else if(dir == 'R') {
 			if(orientacao == NORTE) {
-				acrescenta_caminho(1,0, i);
+				acrescenta_caminho(&local, n, 0, i);
 			}
 			else if(orientacao == LESTE) {
-				acrescenta_caminho(0,-1, i);
+				acrescenta_caminho(&local, 0, -n, i);
 			}
 			else if(orientacao == OESTE) {
-				acrescenta_caminho(0,1, i);
+				acrescenta_caminho(&local, 0, n, i);
 			}
 			else if(orientacao == SUL) {
-				acrescenta_caminho(-1,0, i);
+				acrescenta_caminho(&local, -n, 0, i);
 			}
 		}
-		else if(path[i] == 'L') {
+		else if(dir == 'L') {
 			if(orientacao == NORTE) {
-				acrescenta_caminho(-1,0, i);
+				acrescenta_caminho(&local, -n, 0, i);
 			}
 			else if(orientacao == LESTE) {
-				acrescenta_caminho(0,1, i);
+				acrescenta_caminho(&local, 0, n, i);
 			}
 			else if(orientacao == OESTE) {
-				acrescenta_caminho(0,-1, i);
+				acrescenta_caminho(&local, 0, -n, i);
 			}
 			else if(orientacao == SUL) {
-				acrescenta_caminho(1,0, i);
+				acrescenta_caminho(&local, n, 0, i);
 			}
 		}
 
-		troca_orientacao(path[i]);
-
-		/* Guarda o antigo caminho para ser usado se reconhecido depois */
-		antigo_path[i] = path[i];
+		troca_orientacao(dir);
 	}
 
 	orientacao = orientacao_antiga;
@@ -514,60 +776,63 @@ void gira(char nova_orientacao) {
 		return;
 	}
 
+	/* O giro entra no caminho sem segmento antes dele */
+	distancia[path.n] = 0;
+
 	if(nova_orientacao == NORTE) {
 		if(orientacao == LESTE) {
 			turn('L');
-			path[path_length++] = 'L';
+			caminho_acrescenta(&path, 'L');
 		}
 		else if(orientacao == SUL) {
 			turn('B');
-			path[path_length++] = 'B';
+			caminho_acrescenta(&path, 'B');
 		}
 		else if(orientacao == OESTE) {
 			turn('R');
-			path[path_length++] = 'R';
+			caminho_acrescenta(&path, 'R');
 		}
 	}
 	else if(nova_orientacao == LESTE) {
 		if(orientacao == SUL) {
 			turn('L');
-			path[path_length++] = 'L';
+			caminho_acrescenta(&path, 'L');
 		}
 		else if(orientacao == OESTE) {
 			turn('B');
-			path[path_length++] = 'B';
+			caminho_acrescenta(&path, 'B');
 		}
 		else if(orientacao == NORTE) {
 			turn('R');
-			path[path_length++] = 'R';
+			caminho_acrescenta(&path, 'R');
 		}
 	}
 	else if(nova_orientacao == SUL) {
 		if(orientacao == OESTE) {
 			turn('L');
-			path[path_length++] = 'L';
+			caminho_acrescenta(&path, 'L');
 		}
 		else if(orientacao == NORTE) {
 			turn('B');
-			path[path_length++] = 'B';
+			caminho_acrescenta(&path, 'B');
 		}
 		else if(orientacao == LESTE) {
 			turn('R');
-			path[path_length++] = 'R';
+			caminho_acrescenta(&path, 'R');
 		}
 	}
 	else if(nova_orientacao == OESTE) {
 		if(orientacao == NORTE) {
 			turn('L');
-			path[path_length++] = 'L';
+			caminho_acrescenta(&path, 'L');
 		}
 		else if(orientacao == LESTE) {
 			turn('B');
-			path[path_length++] = 'B';
+			caminho_acrescenta(&path, 'B');
 		}
 		else if(orientacao == SUL) {
 			turn('R');
-			path[path_length++] = 'R';
+			caminho_acrescenta(&path, 'R');
 		}
 	}
 
@@ -579,117 +844,122 @@ void atualiza_path(int pos) {
 
 	int i;
 
-	ponte = path_length;
+	ponte = path.n;
 
 	for(i = pos + 2 ; i < tam_percurso_memorizado; i++) {
 
-		path[path_length++] = percurso[i].dir;
+		distancia[path.n] = percurso[i].distancia;
+		caminho_acrescenta(&path, acao_entre(percurso[i - 1].saida, percurso[i].saida));
 	}
 
 	display_path();
 
 }
 
-/* Checa todo vetor de posicoes ja passadas para saber se ja passou por ali */
-int testa_se_ja_passou(char dir) {
+/* Checa todo vetor de posicoes ja passadas para saber se ja passou por ali;
+ * devolve o indice no percurso ou -1 */
+int testa_se_ja_passou() {
 	
 	int i;
 
-	for(i = 0; i < tam_percurso_memorizado; i++) {
+	/* Quase sempre o mapa ja responde que nao, sem percorrer o vetor */
+	if(!mapa_visitado(local_robo.x, local_robo.y))
+		return -1;
+
+	/* O ultimo eh a chegada, que examina_cruzamento ja reconhece */
+	for(i = 0; i < tam_percurso_memorizado - 1; i++) {
 		/* Se estamos em um local que ele ja passou */
 		if(percurso[i].posicao.x == local_robo.x && percurso[i].posicao.y == local_robo.y) {
+			return i;
+		}
+	}
 
-			turn(dir);
-			troca_orientacao(dir);
 
-			follow_segment();
+	return -1;
 
-			/* Fica com os sensores em cima da linha */
-			set_motors(50,50);
-			delay_ms(50);
+}
 
-			/* Fica com as rodas em cima da linha */
-			set_motors(40,40);
-			delay_ms(200);
+/* Chegou no cruzamento 'i' do percurso: gira para sair dele como o
+ * percurso saia e continua pelo caminho antigo */
+void retoma_percurso(int i, unsigned int dist) {
 
-			path[path_length++] = dir;
+	/* percurso[i + 1] eh a acao tomada neste cruzamento */
+	char dir = direcao_para(percurso[i + 1].saida);
 
-			/* Gira para ficar como estava na posicao em que passou por ali */
-			gira(percurso[i].orientacao);
+	vira(dir);
+	troca_orientacao(dir);
 
+	distancia[path.n] = dist;
+	caminho_acrescenta(&path, dir);
 
-			atualiza_path(i);
-			return 1;
-		}
-	}
-
+	atualiza_path(i);
+}
 
-	return 0;
+/* Velocidade para sair do cruzamento depois de 'dir': seguindo reto o
+ * robo nao parou nele */
+int velocidade_de_partida(char dir) {
 
+	return dir == 'S' ? follow_segment_velocidade_atual() : VELOCIDADE_SAIDA;
 }
 
-/* Atualiza a posicao atual do robo e testa se ele ja passou por ali */
-int atualiza_e_checa(char dir) {
+/* Vira no cruzamento, so parando nele se nao for seguir reto, e anota no
+ * modelo de custo do mapa quanto tempo isso levou */
+void vira(char dir) {
+
+	unsigned long inicio_ms = get_ms();
+
+	telemetria_cruzamento(dir, local_robo.x, local_robo.y, orientacao);
+	caixa_preta_cruzamento(dir, local_robo.x, local_robo.y);
 
 	if(dir == 'S') {
-		if(orientacao == NORTE) {
-			local_robo.y += 1;
-		}
-		else if(orientacao == LESTE) {
-			local_robo.x += 1;
-		}
-		else if(orientacao == OESTE) {
-			local_robo.x += -1;
-		}
-		else if(orientacao == SUL) {
-			local_robo.y += -1;
-		}
-	}
-	else if(dir == 'R') {
-		if(orientacao == NORTE) {
-			local_robo.x += 1;
-		}
-		else if(orientacao == LESTE) {
-			local_robo.y += -1;
-		}
-		else if(orientacao == OESTE) {
-			local_robo.y += 1;
-		}
-		else if(orientacao == SUL) {
-			local_robo.x += -1;
-		}
+		turn(dir);
+		return;
 	}
-	else if(dir == 'L') {
-		if(orientacao == NORTE) {
-			local_robo.x += -1;
-		}
-		else if(orientacao == LESTE) {
-			local_robo.y += 1;
-		}
-		else if(orientacao == OESTE) {
-			local_robo.y += -1;
-		}
-		else if(orientacao == SUL) {
-			local_robo.x += 1;
-		}
+
+	// As rodas vao ate o cruzamento.
+	alinha_no_cruzamento();
+	turn(dir);
+
+	mapa_mede(dir == 'B' ? MAPA_CUSTO_VOLTA : MAPA_CUSTO_CURVA, get_ms() - inicio_ms);
+}
+
+#if CAIXA_PRETA
+/* Quem segura C ao tirar o robo da pista encerra a corrida e ve a caixa
+ * preta. O mapa e os tempos ficaram pela metade e o robo esta na mao de
+ * alguem, entao nao volta para o resolvedor: so o reset sai daqui. */
+void encerra_e_mostra_caixa_preta() {
+
+	set_motors(0,0);
+
+	while(1) {
+		caixa_preta_mostra();
+
+		clear();
+		print("Reset");
+		lcd_goto_xy(0,1);
+		print("C:caixa");
+		wait_for_button_press(BUTTON_C);
 	}
-	else if(dir == 'B') {
-		if(orientacao == NORTE) {
-			local_robo.y += -1;
-		}
-		else if(orientacao == LESTE) {
-			local_robo.x += -1;
-		}
-		else if(orientacao == OESTE) {
-			local_robo.x += 1;
-		}
-		else if(orientacao == SUL) {
-			local_robo.y += 1;
-		}
+}
+#endif
+
+/* Depois do follow_segment(): anda no mapa o tanto de celulas do segmento */
+void anda_segmento() {
+
+#if CAIXA_PRETA
+	if(button_is_pressed(BUTTON_C)) {
+		encerra_e_mostra_caixa_preta();
 	}
+#endif
+
+	mapa_registra_segmento(&local_robo.x, &local_robo.y, orientacao, follow_segment_celulas());
+}
 
-	return testa_se_ja_passou(dir);
+/* Troca o caminho pelo menor caminho no mapa, se o mapa tiver um */
+void planeja_caminho() {
 
+	mapa_planeja(X_ROBO, Y_ROBO, ORIENTACAO_INICIAL, local_saida.x, local_saida.y,
+				 &path, distancia, CAMINHO_MAX);
 }
 
 void printa_local() {
@@ -781,16 +1051,30 @@ void resolve_e_reaprende() {
 
 	while(1) {
 
-		orientacao = NORTE;
+		/* A proxima corrida vai pelo menor caminho do que ja se viu */
+		planeja_caminho();
+
+		orientacao = ORIENTACAO_INICIAL;
+		local_robo.x = X_ROBO;
+		local_robo.y = Y_ROBO;
+#ifdef THESEUS
+		theseus_limpa(X_ROBO, Y_ROBO, ORIENTACAO_INICIAL);
+#endif
 
 		// Beep to show that we finished the maze.
 		set_motors(0,0);
+
+		/* O que aprendeu sobrevive ao robo ser desligado */
+		memoria_grava(&path, distancia, local_saida.x, local_saida.y);
 		play(">>a32");
 
 		// Wait for the user to press a button, while displaying
-		// the solution.
+		// the solution.  C mostra a caixa preta da corrida.
 		while(!button_is_pressed(BUTTON_B))
 		{
+			if(button_is_pressed(BUTTON_C))
+				caixa_preta_mostra();
+
 			if(get_ms() % 2000 < 1000)
 			{
 				//clear();
@@ -804,55 +1088,86 @@ void resolve_e_reaprende() {
 		}
 		while(button_is_pressed(BUTTON_B));
 
+		/* A caixa preta vai pela serial e recomeca com a nova corrida */
+		caixa_preta_despeja();
+		caixa_preta_limpa();
+
 		delay_ms(1000);
 
 		clear();
 
-		/* Comecaa resolver e verificar se o local esta certo */
+		/* Comecaa resolver e verificar se o local esta certo. Depois de
+		 * passar reto por um cruzamento o robo nao parou: o proximo
+		 * segmento sai na velocidade em que ele vinha. */
 		int i = 0;
+		int partida = VELOCIDADE_SAIDA;
 		while(1) {
 
-			/* Acha o proximo bloco */
-			follow_segment();
+			/* Acha o proximo bloco. Se la for para seguir reto, vai rapido;
+			 * se for curva e sabemos o tamanho do segmento, vai rapido e
+			 * freia a tempo de chegar na velocidade de curva. */
+			unsigned long inicio_ms = get_ms();
+			char passo = caminho_passo(&path, i);
 
-			/* Fica com os sensores em cima da linha */
-			set_motors(50,50);
-			delay_ms(50);
+			if(passo == 'S')
+				follow_segment_velocidade(partida, VELOCIDADE_RETA, VELOCIDADE_RETA, 0);
+			else if(i < path.n && distancia[i])
+				follow_segment_velocidade(partida, VELOCIDADE_RETA, VELOCIDADE_CURVA, distancia[i]);
+			else
+				follow_segment_velocidade(partida, VELOCIDADE_CURVA, VELOCIDADE_CURVA, 0);
 
-			/* Testa os sensores */
-			unsigned char found_left=0;
-			unsigned char found_straight=0;
-			unsigned char found_right=0;
+			unsigned int ms = get_ms() - inicio_ms;
+			unsigned int dist = follow_segment_distancia();
 
-			unsigned int sensors[5];
-			read_line(sensors,IR_EMITTERS_ON);
+			anda_segmento();
 
-			if(sensors[0] > 100)
-				found_left = 1;
-			if(sensors[4] > 100)
-				found_right = 1;
+			/* O modelo de custo do planejador usa os tempos da repeticao:
+			 * o segmento que acaba em reta da o tempo por celula, o que
+			 * acaba em curva o que se perde freando */
+			if(i < path.n) {
+				unsigned char n = follow_segment_celulas();
 
-			/* Fica com as rodas em cima da linha */
-			set_motors(40,40);
-			delay_ms(200);
+				if(passo == 'S')
+					mapa_mede(MAPA_CUSTO_CELULA, ms / n);
+				else {
+					/* Com sinal: um segmento curto pode bater a estimativa
+					 * por celula, e sem frear nao se perde nada */
+					long frenagem = (long)ms - (long)n * mapa_custo[MAPA_CUSTO_CELULA];
+
+					mapa_mede(MAPA_CUSTO_FRENAGEM, frenagem < 0 ? 0 : (int)frenagem);
+				}
+			}
 
-			// Check for a straight exit.
-			read_line(sensors,IR_EMITTERS_ON);
-			if(sensors[1] > 200 || sensors[2] > 200 ||	 sensors[3] > 200)
-				found_straight = 1;
+			/* Testa os sensores sem parar */
+			unsigned char found_left=0;
+			unsigned char found_straight=0;
+			unsigned char found_right=0;
 
 			/* Ele descobre se a saida saiu do lugar */
-			if(sensors[1] > 600 && sensors[2] > 600 && sensors[3] > 600)
+			if(examina_cruzamento(&found_left, &found_straight, &found_right)) {
+				local_saida = local_robo;
+				saida_conhecida = 1;
 				break;			
+			}
 
-			/* Checa se a saida corresponde com a esperada */
-			if(caminho_certo(found_left, found_straight, found_right, path[i])) {
+			mapa_registra_cruzamento(local_robo.x, local_robo.y, orientacao,
+									 found_left, found_straight, found_right);
+
+			/* Checa se a saida corresponde com a esperada. Se o caminho
+			 * acabou sem a chegada aparecer, ela mudou de lugar; se o
+			 * segmento nao teve o tamanho que o caminho esperava, sumiu ou
+			 * apareceu um cruzamento no meio dele. Nos dois casos reaprende
+			 * daqui, como num cruzamento que mudou. */
+			if(i < path.n &&
+			   (!distancia[i] || follow_segment_celulas() == follow_segment_celulas_de(distancia[i])) &&
+			   caminho_certo(found_left, found_straight, found_right, passo)) {
 				
 				/* Se estiver tudo bem, soh vai */
-				turn(path[i]);
+				vira(passo);
+				partida = velocidade_de_partida(passo);
 
 				/* Vai guardando ateh descobrir orientacao */
-				troca_orientacao(path[i]);
+				troca_orientacao(passo);
 
 				char string[2];
 
@@ -869,25 +1184,28 @@ void resolve_e_reaprende() {
 				clear();
 				//print("MUDOU!");				
 
-				/* Guarda o antigo caminho ate onde parou */
+				/* Guarda o antigo caminho ate onde parou. O percurso de uma
+				 * mudanca anterior ja foi copiado para path: o que ainda vale
+				 * dele esta de i em diante, e o resto leva a este passo que
+				 * nao existe mais, entao retomar nele rodaria para sempre. */
+				tam_percurso_memorizado = 0;
 				guarda_caminho_anterior(i);
 
 				//printa_posicoes_futuras();
 
 				/* Atualiza o novo tamanho */
-				path_length = i;
+				path.n = i;
 
 				/* Termina de ver o local para saber onde ir */
 				unsigned char dir = select_turn(found_left, found_straight, found_right);				
-				turn(dir);
+				vira(dir);
 
-				path[path_length] = dir;
+				distancia[path.n] = dist;
 
-				atualiza_e_checa(dir);
 				troca_orientacao(dir);
 
 
-				path_length++;
+				caminho_acrescenta(&path, dir);
 
 				// Simplify the learned path.
 				simplify_path();
@@ -902,72 +1220,49 @@ void resolve_e_reaprende() {
 
 
 				/* A partir de agora, comeca o algoritmo de resolucao do labirinto, mas sempre vendo se ja passou por um local */
+				char chegou = 0;
 				while(1) {
 
-					
-
 					// FIRST MAIN LOOP BODY  
-					follow_segment();					
+					follow_segment();
+					dist = follow_segment_distancia();
 
-					// Drive straight a bit.  This helps us in case we entered the
-					// intersection at an angle.
-					// Note that we are slowing down - this prevents the robot
-					// from tipping forward too much.
-					set_motors(50,50);
-					delay_ms(50);
+					anda_segmento();
 
-					
-					found_left=0;
-					found_straight=0;
-					found_right=0;
-
-					// Now read the sensors and check the intersection type.
-					unsigned int sensors[5];
-					read_line(sensors,IR_EMITTERS_ON);
-
-					// Check for left and right exits.
-					if(sensors[0] > 100)
-						found_left = 1;
-					if(sensors[4] > 100)
-						found_right = 1;
-
-					// Drive straight a bit more - this is enough to line up our
-					// wheels with the intersection.
-					set_motors(40,40);
-					delay_ms(200);
-
-					// Check for a straight exit.
-					read_line(sensors,IR_EMITTERS_ON);
-					if(sensors[1] > 200 || sensors[2] > 200 || sensors[3] > 200)
-						found_straight = 1;
-
-					// Check for the ending spot.
-					// If all three middle sensors are on dark black, we have
-					// solved the maze.
-					if(sensors[1] > 600 && sensors[2] > 600 && sensors[3] > 600) {
+					// Examina o cruzamento sem parar. Check for the ending spot.
+					if(examina_cruzamento(&found_left, &found_straight, &found_right)) {
 						/* Tocar buzzer aqui */
+						local_saida = local_robo;
+						saida_conhecida = 1;
+						chegou = 1;
 						break;
 					}
 
-					// Intersection identification is complete.
-					// If the maze has been solved, we can follow the existing
-					// path.  Otherwise, we need to learn the solution.
-					dir = select_turn(found_left, found_straight, found_right);
+					mapa_registra_cruzamento(local_robo.x, local_robo.y, orientacao,
+											 found_left, found_straight, found_right);
 
-					/* Se o local que ele chegou agora faz parte do caminho seguinte ao que ele estava antes, ele sabe resolver */
-					if(atualiza_e_checa(dir)) {
+					/* Se o local que ele chegou agora faz parte do caminho seguinte ao que ele estava antes, ele sabe resolver,
+					 * desde que a saida que o caminho antigo tomava ali ainda exista */
+					int passou = testa_se_ja_passou();
+					if(passou >= 0 && caminho_certo(found_left, found_straight, found_right,
+													direcao_para(percurso[passou + 1].saida))) {
 
-						i = ponte;
+						retoma_percurso(passou, dist);
+						partida = velocidade_de_partida(caminho_passo(&path, ponte - 1));
 
 						/* Vai para a proxima posicao do vetor ja atualizado */
-							
-
+						i = ponte;
 
 						break;
 					}
 
+					// Intersection identification is complete.
+					// If the maze has been solved, we can follow the existing
+					// path.  Otherwise, we need to learn the solution.
+					dir = select_turn(found_left, found_straight, found_right);
+
 					// Make the turn indicated by the path.
-					turn(dir);
+					vira(dir);
 					troca_orientacao(dir);
 
 					string [0] = orientacao;
@@ -976,12 +1271,8 @@ void resolve_e_reaprende() {
 					print(string);
 
 					// Store the intersection in the path variable.
-					path[path_length] = dir;
-					path_length++;
-
-					// You should check to make sure that the path_length does not
-					// exceed the bounds of the array.  We'll ignore that in this
-					// example.
+					distancia[path.n] = dist;
+					caminho_acrescenta(&path, dir);
 
 					// Simplify the learned path.
 					simplify_path();
@@ -996,6 +1287,10 @@ void resolve_e_reaprende() {
 
 
 				}
+
+				/* Chegou reaprendendo: a corrida acabou */
+				if(chegou)
+					break;
 			}
 				
 				
@@ -1016,8 +1311,9 @@ int main() {
 
 	inicializa_mapa();
 
-	/* Começa o algoritmo */
-	resolve_e_aprende();
+	/* Começa o algoritmo, a nao ser que ja saiba o caminho */
+	if(!usa_memoria || !le_memoria())
+		resolve_e_aprende();
 
 
 	resolve_e_reaprende();
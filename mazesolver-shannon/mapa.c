@@ -0,0 +1,562 @@
+/*
+ * mapa.c
+ *
+ * Grade de MAPA_LADO x MAPA_LADO celulas. Cada celula usa meio byte de
+ * paredes: a saida norte nos 2 bits de baixo e a leste nos 2 de cima; a
+ * saida sul de uma celula eh a norte da de baixo, e a oeste eh a leste da
+ * da esquerda. Os visitados ficam em outro vetor, um bit por celula.
+ * Para um labirinto 11x11 sao 221 + 56 bytes.
+ */
+
+#include "mapa.h"
+#include "follow-segment.h"
+#include "caminho.h"
+
+#define N_CELULAS (MAPA_LADO * MAPA_LADO)
+
+static unsigned char paredes[(N_CELULAS + 1) / 2];
+static unsigned char visitados[(N_CELULAS + 7) / 8];
+
+/* Indice da celula, ou -1 se (x,y) esta fora do mapa */
+static int celula(int x, int y)
+{
+	if(x < -MAPA_MAX || x > MAPA_MAX || y < -MAPA_MAX || y > MAPA_MAX)
+		return -1;
+
+	return (y + MAPA_MAX) * MAPA_LADO + (x + MAPA_MAX);
+}
+
+/* Norte = 0, leste = 1, sul = 2, oeste = 3: girar a direita soma 1 */
+static unsigned char indice(char orientacao)
+{
+	switch(orientacao)
+	{
+	case LESTE:
+		return 1;
+	case SUL:
+		return 2;
+	case OESTE:
+		return 3;
+	}
+	return 0;
+}
+
+static const char orientacoes[4] = { NORTE, LESTE, SUL, OESTE };
+static const signed char dx[4] = { 0, 1, 0, -1 };
+static const signed char dy[4] = { 1, 0, -1, 0 };
+
+/* Leva a saida sul ou oeste para a parede guardada na celula vizinha.
+ * Devolve o deslocamento do campo dentro do meio byte (0 ou 2). */
+static unsigned char parede(int *x, int *y, unsigned char lado)
+{
+	if(lado == 2)
+		(*y)--;
+	else if(lado == 3)
+		(*x)--;
+
+	return (lado & 1) ? 2 : 0;
+}
+
+void mapa_limpa()
+{
+	int i;
+
+	for(i = 0; i < (int)sizeof(paredes); i++)
+		paredes[i] = 0;
+	for(i = 0; i < (int)sizeof(visitados); i++)
+		visitados[i] = 0;
+}
+
+char mapa_visitado(int x, int y)
+{
+	int c = celula(x, y);
+
+	if(c < 0)
+		return 1;
+
+	return (visitados[c >> 3] >> (c & 7)) & 1;
+}
+
+void mapa_marca_visitado(int x, int y)
+{
+	int c = celula(x, y);
+
+	if(c >= 0)
+		visitados[c >> 3] |= 1 << (c & 7);
+}
+
+static unsigned char saida(int x, int y, unsigned char lado)
+{
+	unsigned char campo = parede(&x, &y, lado);
+	int c = celula(x, y);
+
+	if(c < 0)
+		return MAPA_DESCONHECIDA;
+
+	return (paredes[c >> 1] >> ((c & 1) * 4 + campo)) & 3;
+}
+
+static void poe_saida(int x, int y, unsigned char lado, unsigned char estado)
+{
+	unsigned char campo = parede(&x, &y, lado);
+	int c = celula(x, y);
+	unsigned char desloca;
+
+	if(c < 0)
+		return;
+
+	desloca = (c & 1) * 4 + campo;
+	paredes[c >> 1] = (paredes[c >> 1] & ~(3 << desloca)) | (estado << desloca);
+}
+
+unsigned char mapa_saida(int x, int y, char orientacao)
+{
+	return saida(x, y, indice(orientacao));
+}
+
+void mapa_poe_saida(int x, int y, char orientacao, unsigned char estado)
+{
+	poe_saida(x, y, indice(orientacao), estado);
+}
+
+char mapa_vira(char orientacao, char dir)
+{
+	unsigned char i = indice(orientacao);
+
+	switch(dir)
+	{
+	case 'R':
+		i++;
+		break;
+	case 'B':
+		i += 2;
+		break;
+	case 'L':
+		i += 3;
+		break;
+	}
+
+	return orientacoes[i & 3];
+}
+
+void mapa_registra_cruzamento(int x, int y, char orientacao, unsigned char found_left,
+							  unsigned char found_straight, unsigned char found_right)
+{
+	unsigned char frente = indice(orientacao);
+
+	mapa_marca_visitado(x, y);
+
+	poe_saida(x, y, frente, found_straight ? MAPA_ABERTA : MAPA_FECHADA);
+	poe_saida(x, y, (frente + 1) & 3, found_right ? MAPA_ABERTA : MAPA_FECHADA);
+	poe_saida(x, y, (frente + 2) & 3, MAPA_ABERTA);
+	poe_saida(x, y, (frente + 3) & 3, found_left ? MAPA_ABERTA : MAPA_FECHADA);
+}
+
+void mapa_registra_segmento(int *x, int *y, char orientacao, unsigned char n)
+{
+	unsigned char frente = indice(orientacao);
+
+	poe_saida(*x, *y, frente, MAPA_ABERTA);
+
+	while(n--) {
+		*x += dx[frente];
+		*y += dy[frente];
+		mapa_marca_visitado(*x, *y);
+
+		// Se o segmento continua, o follow_segment() nao viu nada dos lados.
+		if(n) {
+			poe_saida(*x, *y, frente, MAPA_ABERTA);
+			poe_saida(*x, *y, (frente + 1) & 3, MAPA_FECHADA);
+			poe_saida(*x, *y, (frente + 3) & 3, MAPA_FECHADA);
+		}
+	}
+}
+
+unsigned char mapa_saidas_restantes(int x, int y)
+{
+	unsigned char restantes = 0;
+	unsigned char i;
+
+	for(i = 0; i < 4; i++) {
+		if(saida(x, y, i) != MAPA_FECHADA &&
+		   !mapa_visitado(x + dx[i], y + dy[i]))
+			restantes |= 1 << i;
+	}
+
+	return restantes;
+}
+
+unsigned char mapa_byte(int i)
+{
+	if(i < (int)sizeof(paredes))
+		return paredes[i];
+
+	return visitados[i - sizeof(paredes)];
+}
+
+void mapa_poe_byte(int i, unsigned char valor)
+{
+	if(i < (int)sizeof(paredes))
+		paredes[i] = valor;
+	else
+		visitados[i - sizeof(paredes)] = valor;
+}
+
+/* Modelo de custo do planejador, em ms */
+unsigned int mapa_custo[MAPA_N_CUSTOS] = {
+	MAPA_CUSTO_CELULA_MS,
+	MAPA_CUSTO_CRUZAMENTO_MS,
+	MAPA_CUSTO_CURVA_MS,
+	MAPA_CUSTO_VOLTA_MS,
+	MAPA_CUSTO_FRENAGEM_MS,
+};
+
+void mapa_mede(unsigned char custo, int ms)
+{
+	if(ms < 0)
+		ms = 0;
+
+	// Media movel: cada medida leva 1/4 do caminho ate ela.
+	mapa_custo[custo] += (ms - (int)mapa_custo[custo]) / 4;
+}
+
+/*
+ * Dijkstra da celula de partida ate a de chegada, so por celulas
+ * visitadas e saidas que o robo viu abertas. O estado eh a celula e a
+ * orientacao com que o robo chegou nela, porque o custo de sair depende
+ * de ter que virar. Para caber na pilha, a busca so olha o retangulo das
+ * celulas visitadas (ate MAPA_JANELA de lado): cada estado guarda em 2
+ * bits a orientacao do estado anterior e em 1 bit se ja saiu da fila, e
+ * a fila de prioridade so precisa da frente de onda, que num labirinto
+ * eh curta.
+ */
+
+#define N_ESTADOS (MAPA_JANELA * MAPA_JANELA * 4)
+#define FILA 48
+
+typedef struct Item {
+	unsigned int custo;
+	unsigned int estado;        /* bits 0-9: estado; 10-11: orientacao anterior;
+								 * 12-13: a do primeiro passo */
+} Item;
+
+typedef struct Busca {
+	int x_min;
+	int y_min;
+	int largura;
+	int altura;
+	unsigned char pai[(N_ESTADOS + 3) / 4];
+	unsigned char fechado[(N_ESTADOS + 7) / 8];
+	Item fila[FILA];
+	unsigned char n_fila;
+} Busca;
+
+static int estado(const Busca *b, int x, int y, unsigned char lado)
+{
+	x -= b->x_min;
+	y -= b->y_min;
+
+	if(x < 0 || x >= b->largura || y < 0 || y >= b->altura)
+		return -1;
+
+	return ((y * b->largura + x) << 2) | lado;
+}
+
+static unsigned char pai(const Busca *b, int e)
+{
+	return (b->pai[e >> 2] >> ((e & 3) * 2)) & 3;
+}
+
+/* Heap binario com o menor custo na raiz */
+static char poe_na_fila(Busca *b, unsigned int custo, unsigned int estado)
+{
+	unsigned char i = b->n_fila, acima;
+
+	if(b->n_fila == FILA)
+		return 0;
+
+	b->n_fila++;
+	while(i > 0) {
+		acima = (i - 1) / 2;
+		if(b->fila[acima].custo <= custo)
+			break;
+		b->fila[i] = b->fila[acima];
+		i = acima;
+	}
+	b->fila[i].custo = custo;
+	b->fila[i].estado = estado;
+
+	return 1;
+}
+
+static Item tira_da_fila(Busca *b)
+{
+	Item primeiro = b->fila[0];
+	Item ultimo = b->fila[--b->n_fila];
+	unsigned char i = 0, filho;
+
+	while((filho = 2 * i + 1) < b->n_fila) {
+		if(filho + 1 < b->n_fila && b->fila[filho + 1].custo < b->fila[filho].custo)
+			filho++;
+		if(ultimo.custo <= b->fila[filho].custo)
+			break;
+		b->fila[i] = b->fila[filho];
+		i = filho;
+	}
+	b->fila[i] = ultimo;
+
+	return primeiro;
+}
+
+/* Chegando em (x,y) andando para 'lado', o robo para ali (cruzamento,
+ * curva ou beco)? Se nao parar, ele so pode seguir em frente. */
+static char para_em(int x, int y, unsigned char lado)
+{
+	return saida(x, y, lado) != MAPA_ABERTA ||
+		saida(x, y, (lado + 1) & 3) == MAPA_ABERTA ||
+		saida(x, y, (lado + 3) & 3) == MAPA_ABERTA;
+}
+
+/* ... e saindo para 'depois', o cruzamento entra no caminho? */
+static char eh_no(int x, int y, unsigned char lado, unsigned char depois)
+{
+	return depois != lado || para_em(x, y, lado);
+}
+
+/* Custo de sair de (x,y), onde chegou andando para 'lado', para 'depois' */
+static unsigned int custo_de_sair(int x, int y, unsigned char lado, unsigned char depois)
+{
+	unsigned int custo = mapa_custo[MAPA_CUSTO_CELULA];
+
+	if(depois == lado) {
+		if(eh_no(x, y, lado, depois))
+			custo += mapa_custo[MAPA_CUSTO_CRUZAMENTO];
+	}
+	else if(depois == ((lado + 2) & 3))
+		custo += mapa_custo[MAPA_CUSTO_VOLTA] + mapa_custo[MAPA_CUSTO_FRENAGEM];
+	else
+		custo += mapa_custo[MAPA_CUSTO_CURVA] + mapa_custo[MAPA_CUSTO_FRENAGEM];
+
+	return custo;
+}
+
+/* O retangulo das celulas visitadas; 0 se nao couber na busca */
+static char janela(Busca *b)
+{
+	int x, y, x_max = -MAPA_MAX - 1, y_max = -MAPA_MAX - 1;
+
+	b->x_min = MAPA_MAX + 1;
+	b->y_min = MAPA_MAX + 1;
+
+	for(y = -MAPA_MAX; y <= MAPA_MAX; y++) {
+		for(x = -MAPA_MAX; x <= MAPA_MAX; x++) {
+			if(!mapa_visitado(x, y))
+				continue;
+			if(x < b->x_min)
+				b->x_min = x;
+			if(x > x_max)
+				x_max = x;
+			if(y < b->y_min)
+				b->y_min = y;
+			if(y > y_max)
+				y_max = y;
+		}
+	}
+
+	b->largura = x_max - b->x_min + 1;
+	b->altura = y_max - b->y_min + 1;
+
+	return b->largura > 0 && b->largura <= MAPA_JANELA &&
+		b->altura > 0 && b->altura <= MAPA_JANELA;
+}
+
+/* Vale como chegada de busca() qualquer celula que ainda tem saidas a ver */
+#define INEXPLORADO (MAPA_MAX + 1)
+
+static void limpa_busca(Busca *b)
+{
+	int i;
+
+	for(i = 0; i < (int)sizeof(b->pai); i++)
+		b->pai[i] = 0;
+	for(i = 0; i < (int)sizeof(b->fechado); i++)
+		b->fechado[i] = 0;
+	b->n_fila = 0;
+}
+
+/*
+ * Dijkstra do estado 'inicio' ate a celula (x1,y1) ou, se x1 for
+ * INEXPLORADO, ate a mais perto que ainda tem saidas a ver. Se
+ * 'vira_na_largada' for 0, o robo so sai da largada em frente. Devolve o
+ * estado de chegada, com a orientacao do primeiro passo nos bits 12-13,
+ * ou -1.
+ */
+static int busca(Busca *b, int inicio, char vira_na_largada, int x1, int y1)
+{
+	Item item;
+	int e, x, y, k;
+	unsigned char lado, depois, primeiro;
+
+	poe_na_fila(b, 0, inicio);
+
+	while(1) {
+		if(!b->n_fila)
+			return -1;
+
+		item = tira_da_fila(b);
+		e = item.estado & 0x3ff;
+		if(b->fechado[e >> 3] & (1 << (e & 7)))
+			continue;
+
+		b->fechado[e >> 3] |= 1 << (e & 7);
+		b->pai[e >> 2] |= ((item.estado >> 10) & 3) << ((e & 3) * 2);
+
+		lado = e & 3;
+		x = b->x_min + (e >> 2) % b->largura;
+		y = b->y_min + (e >> 2) / b->largura;
+
+		if(x1 == INEXPLORADO ? e != inicio && mapa_saidas_restantes(x, y) : x == x1 && y == y1)
+			return e | (item.estado & 0x3000);
+
+		for(depois = 0; depois < 4; depois++) {
+			// Na largada o robo so sabe seguir em frente.
+			if(e == inicio && !vira_na_largada && depois != lado)
+				continue;
+			// E so vira onde para.
+			if(depois != lado && e != inicio && !para_em(x, y, lado))
+				continue;
+			if(saida(x, y, depois) != MAPA_ABERTA)
+				continue;
+
+			k = estado(b, x + dx[depois], y + dy[depois], depois);
+			if(k < 0 || !mapa_visitado(x + dx[depois], y + dy[depois]) ||
+			   (b->fechado[k >> 3] & (1 << (k & 7))))
+				continue;
+
+			primeiro = e == inicio ? depois : (item.estado >> 12) & 3;
+			if(!poe_na_fila(b, item.custo + custo_de_sair(x, y, lado, depois),
+							k | ((unsigned int)lado << 10) | ((unsigned int)primeiro << 12)))
+				return -1;
+		}
+	}
+}
+
+int mapa_planeja(int x0, int y0, char orientacao, int x1, int y1,
+				 Caminho *path, unsigned int *distancia, int max)
+{
+	Busca b;
+	int i, e, inicio, x, y, n = 0, total = 0, k, conta;
+	unsigned char lado, depois;
+
+	if(!janela(&b) || estado(&b, x0, y0, 0) < 0 || estado(&b, x1, y1, 0) < 0)
+		return -1;
+
+	limpa_busca(&b);
+	inicio = estado(&b, x0, y0, indice(orientacao));
+
+	e = busca(&b, inicio, 0, x1, y1);
+	if(e < 0)
+		return -1;
+	e &= 0x3ff;
+
+	/* Volta da chegada ate a partida duas vezes: a primeira conta os
+	 * cruzamentos, a segunda escreve o caminho de tras para frente */
+	for(k = 0; k < 2; k++) {
+		i = -1;
+		x = x1;
+		y = y1;
+		lado = e & 3;
+		depois = 4;
+		conta = 0;
+		n = total;
+
+		while(estado(&b, x, y, lado) != inicio) {
+			if(depois < 4 && eh_no(x, y, lado, depois)) {
+				if(k == 0)
+					n++;
+				else {
+					if(i >= 0)
+						distancia[i] = follow_segment_distancia_de(conta);
+					i = --n;
+					caminho_poe(path, i, "SRBL"[(depois - lado) & 3]);
+					conta = 0;
+				}
+			}
+
+			depois = lado;
+			lado = pai(&b, estado(&b, x, y, lado));
+			x -= dx[depois];
+			y -= dy[depois];
+			conta++;
+		}
+
+		if(k == 0) {
+			if(n > max || n > CAMINHO_MAX)
+				return -1;
+			total = n;
+			path->n = n;
+		}
+		else if(i >= 0)
+			distancia[i] = follow_segment_distancia_de(conta);
+	}
+
+	return total;
+}
+
+/* Distancia de Manhattan ate o alvo */
+static int ate_o_alvo(int x, int y, int xa, int ya)
+{
+	return (x > xa ? x - xa : xa - x) + (y > ya ? y - ya : ya - y);
+}
+
+char mapa_explora(int x, int y, char orientacao, char alvo, int xa, int ya)
+{
+	Busca b;
+	unsigned char frente = indice(orientacao);
+	unsigned char restantes = mapa_saidas_restantes(x, y);
+	unsigned char i, lado, melhor = 4;
+	int d, menor = 0, e;
+
+	// Esquerda, frente e direita, nesta ordem: sem alvo, ou no empate,
+	// fica a mais a esquerda, como a mao na parede.
+	for(i = 3; i < 6; i++) {
+		lado = (frente + i) & 3;
+		if(!(restantes & (1 << lado)))
+			continue;
+
+		d = alvo ? ate_o_alvo(x + dx[lado], y + dy[lado], xa, ya) : 0;
+		if(melhor == 4 || d < menor) {
+			melhor = lado;
+			menor = d;
+		}
+	}
+
+	if(melhor < 4)
+		return orientacoes[melhor];
+
+	// Tudo em volta ja foi visto: volta pelo caminho mais rapido ate o
+	// cruzamento mais perto que ainda tem saidas a ver.
+	if(!janela(&b) || estado(&b, x, y, 0) < 0)
+		return 0;
+
+	limpa_busca(&b);
+	e = busca(&b, estado(&b, x, y, frente), 1, INEXPLORADO, 0);
+
+	// Nao ha mais o que ver, mas a chegada ja esta no mapa: vai para ela.
+	// Sem isso a mao na parede roda para sempre num laco.
+	if(e < 0 && alvo && (x != xa || y != ya) && estado(&b, xa, ya, 0) >= 0) {
+		limpa_busca(&b);
+		e = busca(&b, estado(&b, x, y, frente), 1, xa, ya);
+	}
+	if(e < 0)
+		return 0;
+
+	return orientacoes[(e >> 12) & 3];
+}
+
+// Local Variables: **
+// mode: C **
+// c-basic-offset: 4 **
+// tab-width: 4 **
+// indent-tabs-mode: t **
+// end: **
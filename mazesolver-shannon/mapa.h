@@ -0,0 +1,146 @@
+/*
+ * Mapa do labirinto em grade.
+ *
+ * Cada no da grade do labirinto eh uma celula (x,y), com x e y contados
+ * a partir da largada (X_ROBO, Y_ROBO) e podendo ser negativos; um
+ * segmento longo passa por varias celulas (ver follow_segment_celulas).
+ * A celula guarda se o robo ja passou por ela e o estado das quatro
+ * saidas; as paredes entre duas celulas sao guardadas uma vez so, 2 bits
+ * cada, entao a grade inteira cabe em algumas centenas de bytes.
+ */
+
+#ifndef MAPA_H
+#define MAPA_H
+
+/* Definimos a direcao do robo */
+#define NORTE 'n'
+#define LESTE 'l'
+#define SUL 's'
+#define OESTE 'o'
+
+/* Definicoes sobre o tamanho do labirinto */
+#define LARGURA 11
+#define ALTURA 11
+#define TAM_MAPA LARGURA * ALTURA
+
+/* Maior |x| e |y| que cabem no mapa: o robo pode comecar em qualquer
+ * canto de um labirinto 11x11 */
+#ifndef MAPA_MAX
+#define MAPA_MAX 10
+#endif
+#define MAPA_LADO (2 * MAPA_MAX + 1)
+
+/* Maior lado do retangulo de celulas visitadas em que mapa_planeja()
+ * busca: o labirinto tem 11x11 nos */
+#ifndef MAPA_JANELA
+#define MAPA_JANELA 11
+#endif
+
+/* Estado de uma saida */
+#define MAPA_DESCONHECIDA 0
+#define MAPA_ABERTA 1
+#define MAPA_FECHADA 2
+
+/* Bits de mapa_saidas_restantes() */
+#define MAPA_BIT_NORTE 1
+#define MAPA_BIT_LESTE 2
+#define MAPA_BIT_SUL 4
+#define MAPA_BIT_OESTE 8
+
+void mapa_limpa();
+
+// Fora do mapa nao da para saber: mapa_visitado() responde 1, para quem
+// pergunta ir conferir do jeito antigo.
+char mapa_visitado(int x, int y);
+void mapa_marca_visitado(int x, int y);
+
+unsigned char mapa_saida(int x, int y, char orientacao);
+void mapa_poe_saida(int x, int y, char orientacao, unsigned char estado);
+
+// Marca o cruzamento como visitado e anota as saidas vistas por
+// examina_cruzamento(), chegando nele com a 'orientacao' dada; a saida
+// por onde o robo chegou esta aberta.
+void mapa_registra_cruzamento(int x, int y, char orientacao, unsigned char found_left,
+							  unsigned char found_straight, unsigned char found_right);
+
+// Anda 'n' celulas de (*x,*y) para 'orientacao', marcando-as como
+// visitadas; as do meio do segmento nao tem saidas para os lados.
+void mapa_registra_segmento(int *x, int *y, char orientacao, unsigned char n);
+
+// Saidas abertas (ou ainda nao vistas) que levam a celulas nao visitadas.
+unsigned char mapa_saidas_restantes(int x, int y);
+
+// Orientacao depois de virar para 'dir' ('L', 'S', 'R' ou 'B').
+char mapa_vira(char orientacao, char dir);
+
+/*
+ * Modelo de custo do planejador: quanto tempo (ms) cada coisa leva na
+ * corrida de repeticao. Os valores iniciais sao os do simulador; o
+ * resolvedor passa suas medidas por mapa_mede(), que faz uma media movel.
+ * Para ajustar na mao, troque os defines ou escreva em mapa_custo[].
+ */
+#define MAPA_CUSTO_CELULA 0        /* andar uma celula em reta */
+#define MAPA_CUSTO_CRUZAMENTO 1    /* passar reto por um cruzamento */
+#define MAPA_CUSTO_CURVA 2         /* 'L' ou 'R': alinhar e girar */
+#define MAPA_CUSTO_VOLTA 3         /* 'B' */
+#define MAPA_CUSTO_FRENAGEM 4      /* frear antes de uma curva */
+#define MAPA_N_CUSTOS 5
+
+#ifndef MAPA_CUSTO_CELULA_MS
+#define MAPA_CUSTO_CELULA_MS 320
+#endif
+#ifndef MAPA_CUSTO_CRUZAMENTO_MS
+#define MAPA_CUSTO_CRUZAMENTO_MS 60
+#endif
+#ifndef MAPA_CUSTO_CURVA_MS
+#define MAPA_CUSTO_CURVA_MS 300
+#endif
+#ifndef MAPA_CUSTO_VOLTA_MS
+#define MAPA_CUSTO_VOLTA_MS 450
+#endif
+#ifndef MAPA_CUSTO_FRENAGEM_MS
+#define MAPA_CUSTO_FRENAGEM_MS 100
+#endif
+
+extern unsigned int mapa_custo[MAPA_N_CUSTOS];
+
+void mapa_mede(unsigned char custo, int ms);
+
+// Caminho mais rapido, pelo modelo de custo, de (x0,y0), saindo para
+// 'orientacao', ate (x1,y1), pelo que o robo ja viu do labirinto.
+// Escreve em 'path' a acao de cada cruzamento em que o robo vai parar e
+// em distancia[] o segmento que chega nele (como
+// follow_segment_distancia()). Devolve quantos sao, ou -1 (sem mexer em
+// 'path') se nao achar caminho, se ele tiver mais de 'max' cruzamentos
+// ou se o que ja viu nao couber em MAPA_JANELA.
+struct Caminho;
+int mapa_planeja(int x0, int y0, char orientacao, int x1, int y1,
+				 struct Caminho *path, unsigned int *distancia, int max);
+
+// O mapa inteiro (paredes e visitados) como MAPA_BYTES bytes, para
+// guarda-lo fora da RAM (ver memoria.c).
+#define MAPA_BYTES ((MAPA_LADO * MAPA_LADO + 1) / 2 + (MAPA_LADO * MAPA_LADO + 7) / 8)
+unsigned char mapa_byte(int i);
+void mapa_poe_byte(int i, unsigned char valor);
+
+/*
+ * Exploracao: para onde sair do cruzamento (x,y), ja registrado, onde o
+ * robo chegou andando para 'orientacao'. As celulas visitadas fazem o
+ * papel das marcas de Tremaux: primeiro vem uma saida que leva a celula
+ * nao visitada, a que chega mais perto de (xa,ya) se 'alvo' for 1 e a mais
+ * a esquerda senao; se nao houver, o primeiro passo do caminho mais
+ * rapido ate o cruzamento mais perto que ainda tem saidas a ver ou, se
+ * nao houver nenhum e 'alvo' for 1, ate (xa,ya). Devolve a orientacao de
+ * saida, ou 0 se o mapa nao ajudar (nao acha caminho ou nao cabe em
+ * MAPA_JANELA).
+ */
+char mapa_explora(int x, int y, char orientacao, char alvo, int xa, int ya);
+
+#endif
+
+// Local Variables: **
+// mode: C **
+// c-basic-offset: 4 **
+// tab-width: 4 **
+// indent-tabs-mode: t **
+// end: **
@@ -0,0 +1,198 @@
+/*
+ * memoria.c
+ *
+ * A gravacao eh uma struct Memoria na secao .eeprom. Do caminho so vao
+ * os bytes dos path_length primeiros passos, e a soma (CRC-16 CCITT) cobre
+ * exatamente os bytes gravados, na ordem em que sao gravados.
+ * eeprom_update_byte() so escreve o byte que mudou: uma gravacao igual a
+ * anterior nao gasta a EEPROM (100 mil escritas por byte).
+ */
+
+#include "hal.h"
+#include "mapa.h"
+#include "memoria.h"
+
+typedef struct Memoria {
+	unsigned char versao;
+	unsigned int tamanho;       /* sizeof(Memoria): muda com TAM_MAPA e o mapa */
+	unsigned int path_length;
+	signed char x_saida;
+	signed char y_saida;
+	unsigned char path[CAMINHO_BYTES];   /* como em Caminho */
+	unsigned int distancia[CAMINHO_MAX];
+	unsigned int custo[MAPA_N_CUSTOS];
+	unsigned char mapa[MAPA_BYTES];
+	unsigned short soma;        /* CRC de 16 bits tambem no host */
+} Memoria;
+
+/* Calibracao dos sensores, gravada a parte: ela vale ate para outra pista */
+typedef struct Calibracao {
+	unsigned char versao;
+	unsigned int minimo[MEMORIA_SENSORES];
+	unsigned int maximo[MEMORIA_SENSORES];
+	unsigned short soma;
+} Calibracao;
+
+/* Na imagem da EEPROM (main.eep) a versao eh 0, que nunca vale */
+static Memoria memoria EEMEM = { 0 };
+static Calibracao calibracao EEMEM = { 0 };
+
+static unsigned short crc;
+
+static void soma_byte(unsigned char b)
+{
+	unsigned char i;
+
+	crc ^= (unsigned short)b << 8;
+	for(i = 0; i < 8; i++)
+		crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+}
+
+/* Copia 'n' bytes para a EEPROM, somando */
+static void grava(void *campo, const void *dados, unsigned int n)
+{
+	unsigned char *e = campo;
+	const unsigned char *d = dados;
+
+	while(n--) {
+		soma_byte(*d);
+		eeprom_update_byte(e++, *d++);
+	}
+}
+
+/* Copia 'n' bytes da EEPROM, somando; sem 'dados' so soma */
+static void le(void *dados, const void *campo, unsigned int n)
+{
+	const unsigned char *e = campo;
+	unsigned char *d = dados;
+	unsigned char b;
+
+	while(n--) {
+		b = eeprom_read_byte(e++);
+		soma_byte(b);
+		if(d)
+			*d++ = b;
+	}
+}
+
+/* A soma vai por ultimo: se o robo for desligado antes, nao vale */
+static void grava_soma(unsigned short *campo)
+{
+	eeprom_update_byte((unsigned char *)campo, crc & 0xff);
+	eeprom_update_byte((unsigned char *)campo + 1, crc >> 8);
+}
+
+static char confere_soma(const unsigned short *campo)
+{
+	unsigned short soma = eeprom_read_byte((const unsigned char *)campo);
+
+	soma |= (unsigned short)eeprom_read_byte((const unsigned char *)campo + 1) << 8;
+
+	return soma == crc;
+}
+
+void memoria_grava(const Caminho *path, const unsigned int *distancia, int x_saida, int y_saida)
+{
+	unsigned char versao = MEMORIA_VERSAO;
+	unsigned int tamanho = sizeof(Memoria);
+	signed char x = x_saida, y = y_saida;
+	unsigned char b;
+	int i;
+
+	crc = 0xffff;
+	grava(&memoria.versao, &versao, 1);
+	grava(&memoria.tamanho, &tamanho, sizeof(tamanho));
+	grava(&memoria.path_length, &path->n, sizeof(path->n));
+	grava(&memoria.x_saida, &x, 1);
+	grava(&memoria.y_saida, &y, 1);
+	grava(memoria.path, path->passos, (path->n + 3) / 4);
+	grava(memoria.distancia, distancia, path->n * sizeof(unsigned int));
+	grava(memoria.custo, mapa_custo, sizeof(memoria.custo));
+
+	for(i = 0; i < MAPA_BYTES; i++) {
+		b = mapa_byte(i);
+		grava(&memoria.mapa[i], &b, 1);
+	}
+
+	grava_soma(&memoria.soma);
+}
+
+char memoria_valida()
+{
+	unsigned char versao;
+	unsigned int tamanho, path_length;
+
+	crc = 0xffff;
+	le(&versao, &memoria.versao, 1);
+	le(&tamanho, &memoria.tamanho, sizeof(tamanho));
+	le(&path_length, &memoria.path_length, sizeof(path_length));
+
+	if(versao != MEMORIA_VERSAO || tamanho != sizeof(Memoria) || path_length > CAMINHO_MAX)
+		return 0;
+
+	le(0, &memoria.x_saida, 2);
+	le(0, memoria.path, (path_length + 3) / 4);
+	le(0, memoria.distancia, path_length * sizeof(unsigned int));
+	le(0, memoria.custo, sizeof(memoria.custo));
+	le(0, memoria.mapa, MAPA_BYTES);
+
+	return confere_soma(&memoria.soma);
+}
+
+char memoria_le(Caminho *path, unsigned int *distancia, int *x_saida, int *y_saida)
+{
+	signed char x, y;
+	unsigned char b;
+	int i;
+
+	// Primeiro confere tudo, para nao deixar nada pela metade.
+	if(!memoria_valida())
+		return 0;
+
+	le(&path->n, &memoria.path_length, sizeof(path->n));
+	le(&x, &memoria.x_saida, 1);
+	le(&y, &memoria.y_saida, 1);
+	le(path->passos, memoria.path, (path->n + 3) / 4);
+	le(distancia, memoria.distancia, path->n * sizeof(unsigned int));
+	le(mapa_custo, memoria.custo, sizeof(memoria.custo));
+
+	for(i = 0; i < MAPA_BYTES; i++) {
+		le(&b, &memoria.mapa[i], 1);
+		mapa_poe_byte(i, b);
+	}
+
+	*x_saida = x;
+	*y_saida = y;
+
+	return 1;
+}
+
+void memoria_grava_calibracao(const unsigned int *minimo, const unsigned int *maximo)
+{
+	unsigned char versao = MEMORIA_VERSAO_CALIBRACAO;
+
+	crc = 0xffff;
+	grava(&calibracao.versao, &versao, 1);
+	grava(calibracao.minimo, minimo, sizeof(calibracao.minimo));
+	grava(calibracao.maximo, maximo, sizeof(calibracao.maximo));
+	grava_soma(&calibracao.soma);
+}
+
+char memoria_le_calibracao(unsigned int *minimo, unsigned int *maximo)
+{
+	unsigned char versao;
+
+	crc = 0xffff;
+	le(&versao, &calibracao.versao, 1);
+	le(minimo, calibracao.minimo, sizeof(calibracao.minimo));
+	le(maximo, calibracao.maximo, sizeof(calibracao.maximo));
+
+	return versao == MEMORIA_VERSAO_CALIBRACAO && confere_soma(&calibracao.soma);
+}
+
+// Local Variables: **
+// mode: C **
+// c-basic-offset: 4 **
+// tab-width: 4 **
+// indent-tabs-mode: t **
+// end: **
@@ -0,0 +1,50 @@
+/*
+ * Memoria do que o robo aprendeu, na EEPROM do atmega328p: o caminho, a
+ * posicao da chegada, o mapa e o modelo de custo sobrevivem ao robo ser
+ * desligado, e a proxima bateria na mesma pista pode ir direto para a
+ * repeticao (aperte A em vez de B na tela da bateria). A calibracao dos
+ * sensores fica numa gravacao separada, para a largada rapida.
+ *
+ * A gravacao tem versao e soma de verificacao: EEPROM apagada, gravada
+ * por outra versao do programa ou pela metade nao vale. make eeprom gera
+ * a imagem da EEPROM vazia (main.eep).
+ */
+
+#ifndef MEMORIA_H
+#define MEMORIA_H
+
+#include "caminho.h"
+
+/* Troque ao mudar o que eh guardado */
+#define MEMORIA_VERSAO 3
+
+// Grava o caminho e a chegada, mais o mapa e mapa_custo[]. So escreve
+// os bytes que mudaram.
+void memoria_grava(const Caminho *path, const unsigned int *distancia, int x_saida, int y_saida);
+
+// Se ha uma gravacao valida.
+char memoria_valida();
+
+// Le a gravacao de volta, incluindo o mapa e mapa_custo[]; devolve 0 (e
+// nao mexe em nada) se ela nao for valida.
+char memoria_le(Caminho *path, unsigned int *distancia, int *x_saida, int *y_saida);
+
+/* Calibracao dos sensores de linha: minimo e maximo de cada um. Tem
+ * versao propria: mudar o caminho ou o mapa nao apaga a calibracao. */
+#define MEMORIA_SENSORES 5
+#define MEMORIA_VERSAO_CALIBRACAO 1
+
+void memoria_grava_calibracao(const unsigned int *minimo, const unsigned int *maximo);
+
+// Devolve 0 se nao houver calibracao valida gravada; os vetores podem ter
+// sido escritos do mesmo jeito.
+char memoria_le_calibracao(unsigned int *minimo, unsigned int *maximo);
+
+#endif
+
+// Local Variables: **
+// mode: C **
+// c-basic-offset: 4 **
+// tab-width: 4 **
+// indent-tabs-mode: t **
+// end: **
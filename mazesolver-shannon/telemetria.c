@@ -0,0 +1,226 @@
+/*
+ * telemetria.c
+ *
+ * Os quadros vao para uma fila circular de TELEMETRIA_FILA bytes, que a
+ * interrupcao de registrador vazio da USART (USART_UDRE) esvazia um byte
+ * por vez: quem manda um quadro so copia para a fila e volta, e um quadro
+ * que nao cabe inteiro eh perdido. O quadro so entra na fila depois de
+ * escrito, entao a interrupcao nunca manda um quadro pela metade.
+ *
+ * A 250 kbaud (UBRR exato a 20 MHz) saem 25 bytes por ms: um quadro de
+ * controle por volta do PID, ou um de sensores por leitura, mais os
+ * cruzamentos, ainda cabe.
+ */
+
+#include "hal.h"
+#include "telemetria.h"
+
+#ifdef TELEMETRIA
+
+#ifndef TELEMETRIA_BAUD
+#define TELEMETRIA_BAUD 250000UL
+#endif
+
+/* Potencia de 2, no maximo 256 */
+#ifndef TELEMETRIA_FILA
+#define TELEMETRIA_FILA 128
+#endif
+#define MASCARA (TELEMETRIA_FILA - 1)
+
+static unsigned char sequencia;
+static unsigned char saidas;
+
+#ifdef __AVR__
+
+#ifndef F_CPU
+#define F_CPU 20000000UL
+#endif
+
+static unsigned char fila[TELEMETRIA_FILA];
+static volatile unsigned char cabeca;   /* so quem manda mexe */
+static volatile unsigned char cauda;    /* so a interrupcao mexe */
+
+void telemetria_inicia()
+{
+	/* Velocidade dupla: UBRR = F_CPU / (8 * baud) - 1 */
+	UBRR0 = F_CPU / 8 / TELEMETRIA_BAUD - 1;
+	UCSR0A = (1 << U2X0);
+	UCSR0C = (1 << UCSZ01) | (1 << UCSZ00);   /* 8N1 */
+	UCSR0B = (1 << TXEN0);
+}
+
+ISR(USART_UDRE_vect)
+{
+	if(cauda == cabeca) {
+		UCSR0B &= ~(1 << UDRIE0);
+		return;
+	}
+
+	UDR0 = fila[cauda];
+	cauda = (cauda + 1) & MASCARA;
+}
+
+static char cabe(unsigned char n)
+{
+	return ((cauda - cabeca - 1) & MASCARA) >= n;
+}
+
+static void envia(const unsigned char *quadro, unsigned char n)
+{
+	unsigned char c = cabeca;
+
+	if(!cabe(n))
+		return;
+
+	while(n--) {
+		fila[c] = *quadro++;
+		c = (c + 1) & MASCARA;
+	}
+
+	cabeca = c;
+	UCSR0B |= (1 << UDRIE0);
+}
+
+#else
+
+/* No host a serial eh host_serial_escreve(); a fila so eh contada, pelo
+ * tempo virtual em que a USART a esvaziaria */
+#define US_POR_BYTE (10 * 1000000UL / TELEMETRIA_BAUD)
+
+static unsigned long long livre_us;
+
+void telemetria_inicia()
+{
+	livre_us = 0;
+}
+
+static char cabe(unsigned char n)
+{
+	unsigned long long agora = host_tempo_us();
+
+	if(livre_us < agora)
+		livre_us = agora;
+
+	return (livre_us - agora) / US_POR_BYTE + n <= TELEMETRIA_FILA - 1;
+}
+
+static void envia(const unsigned char *quadro, unsigned char n)
+{
+	if(!cabe(n))
+		return;
+
+	livre_us += n * US_POR_BYTE;
+	host_serial_escreve(quadro, n);
+}
+
+#endif
+
+/* Poe o cabecalho e a soma em volta de 'n' bytes de dados */
+static void fecha_e_envia(unsigned char *quadro, unsigned char tipo, unsigned char n)
+{
+	unsigned char soma = 0;
+	unsigned char i;
+
+	quadro[0] = TELEMETRIA_SINCRONIA;
+	quadro[1] = tipo;
+	quadro[2] = sequencia++;
+
+	for(i = 1; i < n + 3; i++)
+		soma += quadro[i];
+	quadro[n + 3] = soma;
+
+	envia(quadro, n + TELEMETRIA_MOLDURA);
+}
+
+static unsigned char *poe_16(unsigned char *p, unsigned int valor)
+{
+	p[0] = valor;
+	p[1] = valor >> 8;
+
+	return p + 2;
+}
+
+#if TELEMETRIA == 2
+
+void telemetria_sensores(char fase, const unsigned int *sensores)
+{
+	unsigned char quadro[TELEMETRIA_DADOS_SENSORES + TELEMETRIA_MOLDURA];
+	unsigned char *dados = poe_16(quadro + 3, get_ms());
+	unsigned char k;
+
+	*dados++ = fase;
+	for(k = 0; k < 5; k++)
+		dados = poe_16(dados, sensores[k]);
+
+	fecha_e_envia(quadro, TELEMETRIA_SENSORES, TELEMETRIA_DADOS_SENSORES);
+}
+
+#else
+
+void telemetria_controle(const unsigned int *sensores, unsigned int posicao,
+						 int p, int i, int d, int m1, int m2)
+{
+	unsigned char quadro[TELEMETRIA_DADOS_CONTROLE + TELEMETRIA_MOLDURA];
+	unsigned char *dados = poe_16(quadro + 3, get_ms());
+	unsigned char k;
+
+	for(k = 0; k < 5; k++)
+		*dados++ = sensores[k] / 4;
+
+	dados = poe_16(dados, posicao);
+	dados = poe_16(dados, p);
+	dados = poe_16(dados, i);
+	dados = poe_16(dados, d);
+	dados = poe_16(dados, m1);
+	poe_16(dados, m2);
+
+	fecha_e_envia(quadro, TELEMETRIA_CONTROLE, TELEMETRIA_DADOS_CONTROLE);
+}
+
+#endif
+
+void telemetria_saidas(unsigned char found_left, unsigned char found_straight,
+					   unsigned char found_right)
+{
+	saidas = (found_left ? 1 : 0) | (found_straight ? 2 : 0) | (found_right ? 4 : 0);
+}
+
+void telemetria_cruzamento(char dir, int x, int y, char orientacao)
+{
+	unsigned char quadro[TELEMETRIA_DADOS_CRUZAMENTO + TELEMETRIA_MOLDURA];
+	unsigned char *dados = poe_16(quadro + 3, get_ms());
+
+	dados[0] = saidas;
+	dados[1] = dir;
+	dados[2] = x;
+	dados[3] = y;
+	dados[4] = orientacao;
+
+	fecha_e_envia(quadro, TELEMETRIA_CRUZAMENTO, TELEMETRIA_DADOS_CRUZAMENTO);
+}
+
+void telemetria_caixa_preta(unsigned int ms, char tipo, unsigned char dados,
+							signed char a, signed char b)
+{
+	unsigned char quadro[TELEMETRIA_DADOS_CAIXA_PRETA + TELEMETRIA_MOLDURA];
+	unsigned char *p = poe_16(quadro + 3, ms);
+
+	p[0] = tipo;
+	p[1] = dados;
+	p[2] = a;
+	p[3] = b;
+
+	while(!cabe(sizeof(quadro)))
+		delay_ms(1);
+
+	fecha_e_envia(quadro, TELEMETRIA_CAIXA_PRETA, TELEMETRIA_DADOS_CAIXA_PRETA);
+}
+
+#endif
+
+// Local Variables: **
+// mode: C **
+// c-basic-offset: 4 **
+// tab-width: 4 **
+// indent-tabs-mode: t **
+// end: **
@@ -0,0 +1,90 @@
+/*
+ * Telemetria pela serial do 3pi (USART0, pino PD1): compile com
+ * TELEMETRIA=1 e ligue um adaptador USB-serial de 5 V em PD1 e GND. Com
+ * TELEMETRIA=2 vai cada leitura dos sensores no lugar das voltas do PID,
+ * para repetir a corrida no host (host/repete-main.c). Sem TELEMETRIA as
+ * chamadas somem.
+ *
+ * Cada quadro eh
+ *   TELEMETRIA_SINCRONIA, tipo, sequencia, dados..., soma
+ * com os numeros em little-endian; a sequencia conta os quadros (os
+ * perdidos por falta de espaco na fila tambem), e a soma eh a de todos os
+ * bytes depois da sincronia, mod 256. host/telemetria-csv.c decodifica.
+ */
+
+#ifndef TELEMETRIA_H
+#define TELEMETRIA_H
+
+#define TELEMETRIA_SINCRONIA 0xa5
+
+/* Uma volta do PID (follow-segment.c):
+ *   ms (16 bits), sensores[5] (calibrados / 4, 8 bits), posicao (16),
+ *   termos p, i e d do PID (16 com sinal), motores m1 e m2 (16 com sinal) */
+#define TELEMETRIA_CONTROLE 'c'
+#define TELEMETRIA_DADOS_CONTROLE 19
+
+/* Um cruzamento (main.c), antes de virar:
+ *   ms (16 bits), saidas (bit 0 esquerda, 1 frente, 2 direita), acao,
+ *   x e y (8 bits com sinal), orientacao */
+#define TELEMETRIA_CRUZAMENTO 'x'
+#define TELEMETRIA_DADOS_CRUZAMENTO 7
+
+/* Uma leitura de read_line() (TELEMETRIA=2):
+ *   ms (16 bits), fase ('p' PID, 'x' cruzamento, 't' giro), sensores[5]
+ *   (calibrados, 16 bits) */
+#define TELEMETRIA_SENSORES 's'
+#define TELEMETRIA_DADOS_SENSORES 13
+
+/* Um evento da caixa preta (caixa-preta.h), mandado depois da corrida:
+ *   ms (16 bits), tipo, dados, a e b (8 bits com sinal) */
+#define TELEMETRIA_CAIXA_PRETA 'p'
+#define TELEMETRIA_DADOS_CAIXA_PRETA 6
+
+/* Sincronia, tipo, sequencia e soma */
+#define TELEMETRIA_MOLDURA 4
+
+#ifdef TELEMETRIA
+
+// Liga a serial; chame depois de pololu_3pi_init().
+void telemetria_inicia();
+
+// Nenhuma destas espera a serial: se a fila estiver cheia, o quadro eh
+// perdido.
+#if TELEMETRIA == 2
+void telemetria_sensores(char fase, const unsigned int *sensores);
+#define telemetria_controle(sensores, posicao, p, i, d, m1, m2)
+#else
+void telemetria_controle(const unsigned int *sensores, unsigned int posicao,
+						 int p, int i, int d, int m1, int m2);
+#define telemetria_sensores(fase, sensores)
+#endif
+
+// examina_cruzamento() guarda as saidas vistas; o quadro sai quando o
+// resolvedor decide a acao.
+void telemetria_saidas(unsigned char found_left, unsigned char found_straight,
+					   unsigned char found_right);
+void telemetria_cruzamento(char dir, int x, int y, char orientacao);
+
+// Este espera ter lugar na fila: nao eh para usar durante a corrida.
+void telemetria_caixa_preta(unsigned int ms, char tipo, unsigned char dados,
+							signed char a, signed char b);
+
+#else
+
+#define telemetria_inicia()
+#define telemetria_controle(sensores, posicao, p, i, d, m1, m2)
+#define telemetria_sensores(fase, sensores)
+#define telemetria_saidas(found_left, found_straight, found_right)
+#define telemetria_cruzamento(dir, x, y, orientacao)
+#define telemetria_caixa_preta(ms, tipo, dados, a, b)
+
+#endif
+
+#endif
+
+// Local Variables: **
+// mode: C **
+// c-basic-offset: 4 **
+// tab-width: 4 **
+// indent-tabs-mode: t **
+// end: **
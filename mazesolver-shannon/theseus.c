@@ -0,0 +1,138 @@
+/*
+ * theseus.c
+ *
+ * A busca em profundidade de maze.c sobre os cruzamentos do labirinto de
+ * fita. Cada cruzamento visitado vira uma Posicao; as saidas testadas ou
+ * fechadas ficam marcadas como erro, na ordem norte, leste, sul e oeste
+ * de testa_saida(). Quando nao sobra saida, volta_posicao() volta por
+ * onde o robo chegou ao cruzamento pela primeira vez. Chegar por um
+ * caminho novo num cruzamento ja visitado fecha um laco: o robo marca a
+ * saida e volta, como no metodo de Tremaux.
+ *
+ * Uma posicao nunca eh liberada, porque ela eh a marca de que o
+ * cruzamento ja foi visitado; como o labirinto tem no maximo LARGURA *
+ * ALTURA cruzamentos, o vetor fixo basta e a memoria eh sempre a mesma.
+ */
+
+#include "hal.h"
+#include "theseus.h"
+
+/* Bits de Posicao.marcas */
+#define ERRO(orientacao) (1 << (orientacao))   /* 0..3: a saida deu errado */
+#define CHEGADA(marcas) (((marcas) >> 4) & 3)  /* por onde chegou a primeira vez */
+#define RAIZ 0x40                              /* a largada: nao tem para onde voltar */
+
+typedef struct Posicao {
+	signed char x;
+	signed char y;
+	unsigned char marcas;
+} Posicao;
+
+static Posicao posicoes[THESEUS_POSICOES];
+static unsigned char n_posicoes;
+
+static const char orientacoes[4] = { NORTE, LESTE, SUL, OESTE };
+
+static unsigned char indice(char orientacao)
+{
+	unsigned char i;
+
+	for(i = 0; i < 3; i++)
+		if(orientacoes[i] == orientacao)
+			break;
+
+	return i;
+}
+
+static Posicao *procura(int x, int y)
+{
+	unsigned char i;
+
+	for(i = 0; i < n_posicoes; i++)
+		if(posicoes[i].x == x && posicoes[i].y == y)
+			return &posicoes[i];
+
+	return 0;
+}
+
+/* Pega a proxima posicao do vetor; 0 se acabou */
+static Posicao *cria_nova_posicao(int x, int y, unsigned char chegada)
+{
+	Posicao *posicao;
+
+	if(n_posicoes == THESEUS_POSICOES)
+		return 0;
+
+	posicao = &posicoes[n_posicoes++];
+	posicao->x = x;
+	posicao->y = y;
+	posicao->marcas = chegada << 4;
+
+	return posicao;
+}
+
+/* Orientacao para voltar ao cruzamento de onde se chegou nesta posicao */
+static char volta_posicao(Posicao *posicao)
+{
+	if(posicao->marcas & RAIZ)
+		return 0;
+
+	return orientacoes[(CHEGADA(posicao->marcas) + 2) & 3];
+}
+
+void theseus_limpa(int x, int y, char orientacao)
+{
+	Posicao *largada;
+
+	n_posicoes = 0;
+
+	// Da largada o robo so sai para a frente, e ninguem volta para ela.
+	largada = cria_nova_posicao(x, y, indice(orientacao));
+	largada->marcas |= RAIZ | ERRO(0) | ERRO(1) | ERRO(2) | ERRO(3);
+}
+
+char theseus_escolhe(int x, int y, char orientacao, unsigned char found_left,
+					 unsigned char found_straight, unsigned char found_right)
+{
+	unsigned char frente = indice(orientacao);
+	unsigned char volta = (frente + 2) & 3;
+	unsigned char i;
+	Posicao *posicao = procura(x, y);
+
+	if(!posicao) {
+		posicao = cria_nova_posicao(x, y, frente);
+		if(!posicao)
+			return 0;
+
+		// Saidas que os sensores nao viram sao erros, e a de tras so
+		// serve para voltar.
+		if(!found_straight)
+			posicao->marcas |= ERRO(frente);
+		if(!found_right)
+			posicao->marcas |= ERRO((frente + 1) & 3);
+		if(!found_left)
+			posicao->marcas |= ERRO((frente + 3) & 3);
+		posicao->marcas |= ERRO(volta);
+	}
+	else if(!(posicao->marcas & ERRO(volta))) {
+		// Caminho novo ate um cruzamento conhecido: nao serve, volta.
+		posicao->marcas |= ERRO(volta);
+		return orientacoes[volta];
+	}
+
+	for(i = 0; i < 4; i++) {
+		if(!(posicao->marcas & ERRO(i))) {
+			posicao->marcas |= ERRO(i);
+			return orientacoes[i];
+		}
+	}
+
+	return volta_posicao(posicao);
+}
+
+// Local Variables: **
+// mode: C **
+// c-basic-offset: 4 **
+// tab-width: 4 **
+// indent-tabs-mode: t **
+// end: **
@@ -0,0 +1,33 @@
+/*
+ * Explorador de Theseus (o de maze.c): busca em profundidade pelos
+ * cruzamentos, com um no por cruzamento ja visitado guardando que saidas
+ * deram errado (erro[] de maze.c). Os nos vem de um vetor fixo de
+ * LARGURA * ALTURA posicoes, sem malloc(); compile com THESEUS=1 para o
+ * resolvedor usar este explorador no lugar de mapa_explora().
+ */
+
+#ifndef THESEUS_H
+#define THESEUS_H
+
+#include "mapa.h"
+
+/* Um no por cruzamento do labirinto */
+#define THESEUS_POSICOES (LARGURA * ALTURA)
+
+// Esquece tudo; o robo esta em (x,y) saindo para 'orientacao'.
+void theseus_limpa(int x, int y, char orientacao);
+
+// No cruzamento (x,y), onde o robo chegou andando para 'orientacao' e
+// viu as saidas dadas: devolve a orientacao para sair, ou 0 se ja tentou
+// tudo (ou o vetor de posicoes acabou).
+char theseus_escolhe(int x, int y, char orientacao, unsigned char found_left,
+					 unsigned char found_straight, unsigned char found_right);
+
+#endif
+
+// Local Variables: **
+// mode: C **
+// c-basic-offset: 4 **
+// tab-width: 4 **
+// indent-tabs-mode: t **
+// end: **
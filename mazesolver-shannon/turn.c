@@ -1,30 +1,76 @@
 /*
  * Code to perform various types of turns.  The delays here had to be
  * calibrated for the 3pi's motors.
+ *
+ * O giro nao tem mais tempo fixo: o robo gira ate o sensor do meio achar
+ * a linha de destino. Antes disso ele gira um angulo minimo as cegas,
+ * para nao pegar de novo a linha de onde saiu, e se a linha nao aparecer
+ * ate o dobro do tempo de um giro normal ele para de girar do mesmo jeito.
+ * Os tempos sao os calibrados a 80 (90 graus em 200 ms), corrigidos para
+ * a velocidade de giro.
  */
 
-#include <pololu/3pi.h>
+#include "hal.h"
+#include "telemetria.h"
+
+// Motor power used to spin.  Como o giro para pelos sensores, da para
+// girar mais forte que os 80 calibrados para o tempo fixo.
+#ifndef VELOCIDADE_GIRO
+#define VELOCIDADE_GIRO 120
+#endif
+
+/* Angulos minimos antes de procurar a linha */
+#define GUARDA_CURVA 45
+#define GUARDA_VOLTA 120
+
+/* O sensor do meio esta sobre a linha */
+#define LINHA_NO_MEIO 500
+
+/* Tempo para girar 'graus' na velocidade de giro */
+static unsigned int tempo_giro_ms(unsigned int graus)
+{
+	return (unsigned int)((long)graus * 200 * 80 / (90L * VELOCIDADE_GIRO));
+}
+
+/* Gira a favor de 'sentido' (1 esquerda, -1 direita) ate achar a linha */
+static void gira_ate_a_linha(int sentido, unsigned int guarda, unsigned int graus)
+{
+	unsigned int sensors[5];
+	unsigned long inicio = get_ms();
+
+	set_motors(-sentido * VELOCIDADE_GIRO, sentido * VELOCIDADE_GIRO);
+	delay_ms(tempo_giro_ms(guarda));
+
+	while(get_ms() - inicio < 2 * tempo_giro_ms(graus))
+	{
+		// A linha entra pelo lado para onde giramos e para quando
+		// chega no meio da barra de sensores.
+		unsigned int position = read_line(sensors, IR_EMITTERS_ON);
+		telemetria_sensores('t', sensors);
+		if(sensors[2] > LINHA_NO_MEIO &&
+		   (sentido > 0 ? position >= 2000 : position <= 2000))
+			break;
+	}
+}
 
 // Turns according to the parameter dir, which should be 'L', 'R', 'S'
-// (straight), or 'B' (back).
+// (straight), or 'B' (back).  The motors are left spinning so that
+// follow_segment() takes over right away.
 void turn(char dir)
 {
 	switch(dir)
 	{
 	case 'L':
 		// Turn left.
-		set_motors(-80,80);
-		delay_ms(200);
+		gira_ate_a_linha(1, GUARDA_CURVA, 90);
 		break;
 	case 'R':
 		// Turn right.
-		set_motors(80,-80);
-		delay_ms(200);
+		gira_ate_a_linha(-1, GUARDA_CURVA, 90);
 		break;
 	case 'B':
 		// Turn around.
-		set_motors(80,-80);
-		delay_ms(400);
+		gira_ate_a_linha(-1, GUARDA_VOLTA, 180);
 		break;
 	case 'S':
 		// Don't do anything!